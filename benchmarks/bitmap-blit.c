@@ -1,8 +1,12 @@
 #include <stdio.h>
+#include <unistd.h>
 #include <sys/time.h>
 
 
+#include "jcfb/batch.h"
 #include "jcfb/bitmap.h"
+#include "jcfb/simd.h"
+#include "jcfb/util.h"
 
 
 #define NITERATIONS 100
@@ -56,6 +60,63 @@ static float _fast_blit_bench() {
 }
 
 
+static float _packed_blit_bench() {
+    bitmap_t bmp_a, bmp_b;
+
+    bitmap_init_packed(&bmp_a, PIXFMT_RGB16, 1920, 1080);
+    bitmap_init_packed(&bmp_b, PIXFMT_RGB16, 1920, 1080);
+
+    struct timeval start, stop;
+
+    gettimeofday(&start, NULL);
+    for (volatile size_t i = 0; i < NITERATIONS; i++) {
+        bitmap_blit(&bmp_a, &bmp_b, 0, 0);
+    }
+    gettimeofday(&stop, NULL);
+    float elapsed = (stop.tv_sec + stop.tv_usec * 1E-6)
+                  - (start.tv_sec + start.tv_usec * 1E-6);
+
+    bitmap_wipe(&bmp_a);
+    bitmap_wipe(&bmp_b);
+
+    return NITERATIONS * (1.0f / elapsed);
+}
+
+
+// Expand a palette-indexed bitmap, cycling its palette every blit.
+static float _palette_blit_bench() {
+    bitmap_t bmp_a, bmp_b;
+
+    bitmap_init(&bmp_a, 1920, 1080);
+    bitmap_init_packed(&bmp_b, PIXFMT_PAL8, 1920, 1080);
+    for (int y = 0; y < bmp_b.h; y++) {
+        for (int x = 0; x < bmp_b.w; x++) {
+            bitmap_put_pixel(&bmp_b, x, y, x ^ y);
+        }
+    }
+    pixel_t colors[256];
+    for (int i = 0; i < 256; i++) {
+        colors[i] = pixel(i * 0x010101);
+    }
+
+    struct timeval start, stop;
+
+    gettimeofday(&start, NULL);
+    for (volatile size_t i = 0; i < NITERATIONS; i++) {
+        bitmap_set_palette(&bmp_b, colors + i % 256, 0, 256 - i % 256);
+        bitmap_blit(&bmp_a, &bmp_b, 0, 0);
+    }
+    gettimeofday(&stop, NULL);
+    float elapsed = (stop.tv_sec + stop.tv_usec * 1E-6)
+                  - (start.tv_sec + start.tv_usec * 1E-6);
+
+    bitmap_wipe(&bmp_a);
+    bitmap_wipe(&bmp_b);
+
+    return NITERATIONS * (1.0f / elapsed);
+}
+
+
 static float _scaled_blit_bench() {
     bitmap_t bmp_a, bmp_b;
 
@@ -79,6 +140,97 @@ static float _scaled_blit_bench() {
 }
 
 
+// A 1024x768 screen filled by a `w` x `h` source.
+static float _resize_blit_bench(void (*blit)(bitmap_t*, const bitmap_t*,
+                                             int, int, int, int),
+                                int w, int h)
+{
+    bitmap_t bmp_a, bmp_b;
+
+    bitmap_init(&bmp_a, 1024, 768);
+    bitmap_init(&bmp_b, w, h);
+    for (int i = 0; i < w * h; i++) {
+        bmp_b.mem[i] = 0x9e3779b9 * i;
+    }
+
+    struct timeval start, stop;
+
+    gettimeofday(&start, NULL);
+    for (volatile size_t i = 0; i < NITERATIONS; i++) {
+        blit(&bmp_a, &bmp_b, 0, 0, 1024, 768);
+    }
+    gettimeofday(&stop, NULL);
+    float elapsed = (stop.tv_sec + stop.tv_usec * 1E-6)
+                  - (start.tv_sec + start.tv_usec * 1E-6);
+
+    bitmap_wipe(&bmp_a);
+    bitmap_wipe(&bmp_b);
+
+    return NITERATIONS * (1.0f / elapsed);
+}
+
+
+// A 256x256 sprite turned by a different angle every blit.
+static float _rotated_blit_bench(void (*blit)(bitmap_t*, const bitmap_t*,
+                                              int, int, float))
+{
+    bitmap_t bmp_a, bmp_b;
+
+    bitmap_init(&bmp_a, 1024, 768);
+    bitmap_init(&bmp_b, 256, 256);
+    for (int i = 0; i < 256 * 256; i++) {
+        bmp_b.mem[i] = 0x9e3779b9 * i;
+    }
+
+    struct timeval start, stop;
+
+    gettimeofday(&start, NULL);
+    for (volatile size_t i = 0; i < NITERATIONS * 10; i++) {
+        blit(&bmp_a, &bmp_b, 512, 384, i * 0.01f);
+    }
+    gettimeofday(&stop, NULL);
+    float elapsed = (stop.tv_sec + stop.tv_usec * 1E-6)
+                  - (start.tv_sec + start.tv_usec * 1E-6);
+
+    bitmap_wipe(&bmp_a);
+    bitmap_wipe(&bmp_b);
+
+    return NITERATIONS * 10 * (1.0f / elapsed);
+}
+
+
+// A 512x384 source doubled on a 1024x768 screen, by a scaled blit or
+// through a transform (`t` not NULL).
+static float _doubled_blit_bench(const affine_t* t) {
+    bitmap_t bmp_a, bmp_b;
+
+    bitmap_init(&bmp_a, 1024, 768);
+    bitmap_init(&bmp_b, 512, 384);
+    for (int i = 0; i < 512 * 384; i++) {
+        bmp_b.mem[i] = 0x9e3779b9 * i;
+    }
+
+    struct timeval start, stop;
+
+    gettimeofday(&start, NULL);
+    for (volatile size_t i = 0; i < NITERATIONS; i++) {
+        if (t) {
+            bitmap_transform_blit(&bmp_a, &bmp_b, t);
+        } else {
+            bitmap_scaled_blit(&bmp_a, &bmp_b, 0, 0, 1024, 768);
+        }
+    }
+    gettimeofday(&stop, NULL);
+    float elapsed = (stop.tv_sec + stop.tv_usec * 1E-6)
+                  - (start.tv_sec + start.tv_usec * 1E-6);
+
+    bitmap_wipe(&bmp_a);
+    bitmap_wipe(&bmp_b);
+
+    return NITERATIONS * (1.0f / elapsed);
+}
+
+
 static float _masked_blit_bench() {
     bitmap_t bmp_a, bmp_b;
 
@@ -102,11 +254,133 @@ static float _masked_blit_bench() {
 }
 
 
-static float _blit_blend_add_bench() {
+// 200 64x64 ring sprites, mostly transparent, blitted masked or from
+// their RLE compilation.
+static float _sprite_blit_bench(bool rle) {
+    bitmap_t bmp_a, bmp_b;
+    bitmap_rle_t sprite;
+
+    bitmap_init(&bmp_a, 1024, 768);
+    bitmap_init(&bmp_b, 64, 64);
+    for (int y = 0; y < 64; y++) {
+        for (int x = 0; x < 64; x++) {
+            int d = (x - 32) * (x - 32) + (y - 32) * (y - 32);
+            bitmap_put_pixel(&bmp_b, x, y, d > 24 * 24 && d < 30 * 30
+                                         ? pixel(0x00ff8000)
+                                         : get_mask_color());
+        }
+    }
+    bitmap_rle_compile(&sprite, &bmp_b);
+
+    struct timeval start, stop;
+
+    gettimeofday(&start, NULL);
+    for (volatile size_t i = 0; i < NITERATIONS; i++) {
+        for (int j = 0; j < 200; j++) {
+            int x = j * 97 % 1000, y = j * 61 % 740;
+            if (rle) {
+                bitmap_rle_blit(&bmp_a, &sprite, x, y);
+            } else {
+                bitmap_blit_masked(&bmp_a, &bmp_b, x, y);
+            }
+        }
+    }
+    gettimeofday(&stop, NULL);
+    float elapsed = (stop.tv_sec + stop.tv_usec * 1E-6)
+                  - (start.tv_sec + start.tv_usec * 1E-6);
+
+    bitmap_rle_wipe(&sprite);
+    bitmap_wipe(&bmp_a);
+    bitmap_wipe(&bmp_b);
+
+    return NITERATIONS * (1.0f / elapsed);
+}
+
+
+// 3000 masked 16x16 sprites of a sprite sheet on a 1920x1080 screen,
+// blitted one at a time (`nthreads` = 0) or batched.
+static float _batch_bench(int nthreads) {
+    bitmap_t bmp_a, bmp_b;
+    pool_t pool;
+    batch_t batch;
+
+    bitmap_init(&bmp_a, 1920, 1080);
+    bitmap_init(&bmp_b, 256, 16);
+    for (int i = 0; i < 256 * 16; i++) {
+        bmp_b.mem[i] = i % 5 ? 0x9e3779b9 * i : get_mask_color();
+    }
+    pool_init(&pool, max(1, nthreads), NULL);
+    batch_init(&batch, &bmp_a, &pool);
+
+    struct timeval start, stop;
+
+    gettimeofday(&start, NULL);
+    for (volatile size_t i = 0; i < NITERATIONS; i++) {
+        for (int j = 0; j < 3000; j++) {
+            int sx = j % 16 * 16;
+            int x = j * 97 % 1920 - 8, y = j * 61 % 1080 - 8;
+            if (nthreads) {
+                batch_add_region(&batch, &bmp_b, sx, 0, 16, 16, x, y,
+                                 BATCH_MASKED, j & 1);
+            } else if (j & 1) {
+                bitmap_blit_hflip_masked(&bmp_a, &bmp_b, x, y);
+            } else {
+                bitmap_blit_masked(&bmp_a, &bmp_b, x, y);
+            }
+        }
+        batch_draw(&batch);
+    }
+    gettimeofday(&stop, NULL);
+    float elapsed = (stop.tv_sec + stop.tv_usec * 1E-6)
+                  - (start.tv_sec + start.tv_usec * 1E-6);
+
+    batch_wipe(&batch);
+    pool_wipe(&pool);
+    bitmap_wipe(&bmp_a);
+    bitmap_wipe(&bmp_b);
+
+    return NITERATIONS * (1.0f / elapsed);
+}
+
+
+// An overlay with transparent, opaque and translucent areas.
+static float _alpha_blit_bench() {
     bitmap_t bmp_a, bmp_b;
 
     bitmap_init_ex(&bmp_a, PIXFMT_RGB24, 1024, 768);
-    bitmap_init_ex(&bmp_b, PIXFMT_RGB24, 1920, 1080);
+    bitmap_init_ex(&bmp_b, PIXFMT_RGBA32, 1024, 768);
+    for (int y = 0; y < bmp_b.h; y++) {
+        for (int x = 0; x < bmp_b.w; x++) {
+            pixel_t alpha = x < 256 ? 0xff : x < 512 ? 0x00 : 0x80;
+            bmp_b.mem[y * bmp_b.w + x] = (alpha << 24) | 0x00404040;
+        }
+    }
+
+    struct timeval start, stop;
+
+    gettimeofday(&start, NULL);
+    for (volatile size_t i = 0; i < NITERATIONS; i++) {
+        bitmap_blit_alpha(&bmp_a, &bmp_b, 0, 0);
+    }
+    gettimeofday(&stop, NULL);
+    float elapsed = (stop.tv_sec + stop.tv_usec * 1E-6)
+                  - (start.tv_sec + start.tv_usec * 1E-6);
+
+    bitmap_wipe(&bmp_a);
+    bitmap_wipe(&bmp_b);
+
+    return NITERATIONS * (1.0f / elapsed);
+}
+
+
+// Pixels are blended in the framebuffer format.
+static float _blit_blend_add_bench(pixfmt_id_t fmt) {
+    bitmap_t bmp_a, bmp_b;
+
+    pixfmt_t fb_fmt = pixfmt_get(fmt);
+    pixfmt_set_fb(&fb_fmt);
+    bitmap_init_ex(&bmp_a, fmt, 1024, 768);
+    bitmap_init_ex(&bmp_b, fmt, 1920, 1080);
 
     struct timeval start, stop;
 
@@ -128,23 +402,73 @@ static float _blit_blend_add_bench() {
 int main(void) {
     float slow_blit_rate = _slow_blit_bench();
     float fast_blit_rate = _fast_blit_bench();
+    float packed_blit_rate = _packed_blit_bench();
+    float palette_blit_rate = _palette_blit_bench();
     float scaled_blit_rate = _scaled_blit_bench();
+    float upscaled_rate = _resize_blit_bench(bitmap_scaled_blit, 800, 600);
+    float upscaled_filtered_rate =
+        _resize_blit_bench(bitmap_scaled_blit_filtered, 800, 600);
+    float halved_rate = _resize_blit_bench(bitmap_scaled_blit, 2048, 1536);
+    float halved_filtered_rate =
+        _resize_blit_bench(bitmap_scaled_blit_filtered, 2048, 1536);
+    float rotated_rate = _rotated_blit_bench(bitmap_rotated_blit);
+    float rotated_filtered_rate =
+        _rotated_blit_bench(bitmap_rotated_blit_filtered);
+    affine_t doubled = affine_scale(affine_identity(), 2, 2);
+    float doubled_rate = _doubled_blit_bench(NULL);
+    float doubled_transform_rate = _doubled_blit_bench(&doubled);
+    affine_t turned = affine_rotate(doubled, 0.1f);
+    float turned_rate = _doubled_blit_bench(&turned);
     float masked_blit_rate = _masked_blit_bench();
-    float blit_blend_add_rate = _blit_blend_add_bench();
+    float sprite_rate = _sprite_blit_bench(false);
+    float sprite_rle_rate = _sprite_blit_bench(true);
+    float alpha_blit_rate = _alpha_blit_bench();
+    float blit_blend_add_rate = _blit_blend_add_bench(PIXFMT_RGB24);
+    float blit_blend_add16_rate = _blit_blend_add_bench(PIXFMT_RGB16);
     float ratio = fast_blit_rate / slow_blit_rate;
 
+    printf("Kernels: %s (JCFB_SIMD selects others)\n",
+           simd_level_name(simd_get_level()));
     printf("Slow blit rate:   %.2f blits/s\n"
            "Fast blit rate:   %.2f blits/s\n"
+           "Packed 16 bits blit rate: %.2f blits/s\n"
+           "Palette blit rate: %.2f blits/s\n"
            "Scaled blit rate: %.2f blits/s\n"
+           "Upscaled blit rate: %.2f blits/s (filtered: %.2f blits/s)\n"
+           "Halved blit rate: %.2f blits/s (filtered: %.2f blits/s)\n"
+           "Rotated sprite rate: %.2f blits/s (filtered: %.2f blits/s)\n"
+           "Doubled blit rate: %.2f blits/s (transform: %.2f blits/s, "
+           "turned: %.2f blits/s)\n"
            "Masked blit rate: %.2f blits/s\n"
+           "Masked sprites rate: %.2f frames/s (RLE: %.2f frames/s)\n"
+           "Alpha blit rate:  %.2f blits/s\n"
            "Additive blending blit rate: %.2f blits/s\n"
+           "Additive blending 16 bits blit rate: %.2f blits/s\n"
            "Fast blit is %.2f times faster than slow blit\n",
            slow_blit_rate,
            fast_blit_rate,
+           packed_blit_rate,
+           palette_blit_rate,
            scaled_blit_rate,
+           upscaled_rate, upscaled_filtered_rate,
+           halved_rate, halved_filtered_rate,
+           rotated_rate, rotated_filtered_rate,
+           doubled_rate, doubled_transform_rate, turned_rate,
            masked_blit_rate,
+           sprite_rate, sprite_rle_rate,
+           alpha_blit_rate,
            blit_blend_add_rate,
+           blit_blend_add16_rate,
            ratio);
 
+    // Batched sprites against the number of threads.
+    int ncpus = max(1, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("Sprite batches (%d CPUs):\n"
+           "  unbatched:  %.2f frames/s\n", ncpus, _batch_bench(0));
+    for (int nthreads = 1; nthreads <= max(4, ncpus); nthreads *= 2) {
+        printf("  %2d threads: %.2f frames/s\n", nthreads,
+               _batch_bench(nthreads));
+    }
+
     return 0;
 }
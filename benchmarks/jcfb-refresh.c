@@ -1,11 +1,97 @@
 #include <stdio.h>
+#include <unistd.h>
 #include <sys/time.h>
 
 #include "jcfb/jcfb.h"
+#include "jcfb/scanout.h"
+#include "jcfb/util.h"
 
 #define NITERATIONS 1000
+#define WIDTH   1920
+#define HEIGHT  1080
+
+
+/*
+ * Time scanout kernel `id` writing to a memory of the given layout.
+ * Returns the refresh rate or a negative value if the kernel doesn't
+ * support the layout.
+ */
+static float _scanout_bench(scanout_id_t id, size_t bits_per_pixel,
+                            size_t line_length, int nthreads)
+{
+    scanout_t so;
+    if (scanout_init_ex(&so, id, bits_per_pixel, line_length, WIDTH) < 0) {
+        return -1.0f;
+    }
+
+    bitmap_t buffer;
+    bitmap_init(&buffer, WIDTH, HEIGHT);
+    bitmap_clear(&buffer, 0x005555EE);
+    void* mem = malloc(line_length * HEIGHT);
+    pool_t pool;
+    pool_init(&pool, nthreads, NULL);
+
+    struct timeval start, stop;
+    gettimeofday(&start, NULL);
+    for (volatile size_t i = 0; i < NITERATIONS / 10; i++) {
+        scanout_copy_pool(&so, &pool, mem, &buffer, 0, 0, WIDTH, HEIGHT);
+    }
+    gettimeofday(&stop, NULL);
+
+    pool_wipe(&pool);
+    free(mem);
+    bitmap_wipe(&buffer);
+
+    float elapsed = (stop.tv_sec + stop.tv_usec * 1E-6)
+                  - (start.tv_sec + start.tv_usec * 1E-6);
+    return NITERATIONS / 10 * (1.0 / elapsed);
+}
+
+
+static void _scanout_benches() {
+    static const struct {
+        scanout_id_t id;
+        size_t bits_per_pixel;
+        size_t line_length;
+    } cases[] = {
+        {SCANOUT_GENERIC, 32, WIDTH * 4},
+        {SCANOUT_BULK32, 32, WIDTH * 4},
+        {SCANOUT_ROWS32, 32, WIDTH * 4 + 64},
+        {SCANOUT_GENERIC, 24, WIDTH * 3},
+        {SCANOUT_PACK24, 24, WIDTH * 3},
+        {SCANOUT_GENERIC, 16, WIDTH * 2},
+        {SCANOUT_PACK16, 16, WIDTH * 2},
+    };
+
+    printf("Scanout kernels (%dx%d, in memory):\n", WIDTH, HEIGHT);
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        float rate = _scanout_bench(cases[i].id, cases[i].bits_per_pixel,
+                                    cases[i].line_length, 1);
+        printf("  %-8s %2zubpp: %.2f refresh/s\n",
+               scanout_name(cases[i].id), cases[i].bits_per_pixel, rate);
+    }
+
+    // Throughput of the default kernels against the number of threads,
+    // in megapixels per second.
+    int ncpus = max(1, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("Scanout threads (%d CPUs):\n", ncpus);
+    for (int nthreads = 1; nthreads <= max(4, ncpus); nthreads *= 2) {
+        printf("  %2d threads:", nthreads);
+        for (size_t bpp = 16; bpp <= 32; bpp += 8) {
+            scanout_t so;
+            scanout_init(&so, bpp, WIDTH * bpp / 8, WIDTH);
+            float rate = _scanout_bench(so.id, bpp, WIDTH * bpp / 8,
+                                        nthreads);
+            printf(" %2zubpp %7.1f Mpx/s", bpp, rate * WIDTH * HEIGHT / 1E6);
+        }
+        printf("\n");
+    }
+}
+
 
 int main(void) {
+    _scanout_benches();
+
     if (jcfb_start() < 0) {
         fprintf(stderr, "unable to start JCFB\n");
         return -1;
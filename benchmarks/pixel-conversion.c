@@ -1,9 +1,30 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/time.h>
 
 #include "jcfb/pixel.h"
+#include "jcfb/simd.h"
 
 #define NITERATIONS 10000000
+#define ROW_WIDTH   1920
+
+
+// Rows converted per second from `in` to `out`.
+static double _rows_rate(pixfmt_id_t in, pixfmt_id_t out,
+                         const pixel_t* src, size_t nrows)
+{
+    static pixel_t dst[ROW_WIDTH];
+    struct timeval start, stop;
+    gettimeofday(&start, NULL);
+    for (volatile size_t i = 0; i < nrows; i++) {
+        pixel_convert_row(in, out, dst, src, ROW_WIDTH);
+    }
+    gettimeofday(&stop, NULL);
+    float elapsed = (stop.tv_sec + stop.tv_usec * 1E-6)
+                  - (start.tv_sec + start.tv_usec * 1E-6);
+    return nrows / elapsed;
+}
+
 
 int main(void) {
     pixfmt_id_t rgb16 = PIXFMT_RGB16;
@@ -21,5 +42,53 @@ int main(void) {
                   - (start.tv_sec + start.tv_usec * 1E-6);
     printf("Rate: %.2f pixels/s\n", NITERATIONS * (1.0 / elapsed));
 
+    gettimeofday(&start, NULL);
+    for (volatile size_t i = 0; i < NITERATIONS; i++) {
+        pixel_to(rgb16, p + i);
+    }
+    gettimeofday(&stop, NULL);
+    elapsed = (stop.tv_sec + stop.tv_usec * 1E-6)
+            - (start.tv_sec + start.tv_usec * 1E-6);
+    printf("Color rate: %.2f colors/s\n", NITERATIONS * (1.0 / elapsed));
+
+    static const char* names[PIXFMT_PAL8] = {
+        [PIXFMT_RGB16] = "RGB16",
+        [PIXFMT_RGB24] = "RGB24",
+        [PIXFMT_BGR24] = "BGR24",
+        [PIXFMT_RGBA32] = "RGBA32",
+        [PIXFMT_ARGB32] = "ARGB32",
+        [PIXFMT_ABGR32] = "ABGR32",
+    };
+    // Consecutive values keep reusing a few entries of the 16 bits
+    // tables, random ones don't.
+    static pixel_t src[ROW_WIDTH], noise[ROW_WIDTH];
+    size_t nrows = NITERATIONS / ROW_WIDTH;
+    srand(1);
+    for (size_t i = 0; i < ROW_WIDTH; i++) {
+        src[i] = p + i;
+        noise[i] = rand() & 0xffff;
+    }
+    for (int l = 0; l < SIMD_LEVEL_MAX; l++) {
+        if (simd_set_level(l) < 0) {
+            continue;
+        }
+        printf("Kernel %s, rows of %d pixels:\n",
+               simd_level_name(l), ROW_WIDTH);
+        for (int in = PIXFMT_RGB16; in < PIXFMT_PAL8; in++) {
+            for (int out = PIXFMT_RGB16; out < PIXFMT_PAL8; out++) {
+                if (in == out) {
+                    continue;
+                }
+                printf("  %-6s -> %-6s %10.2f rows/s\n", names[in],
+                       names[out], _rows_rate(in, out, src, nrows));
+            }
+        }
+        for (int out = PIXFMT_RGB24; out < PIXFMT_PAL8; out++) {
+            printf("  %-6s -> %-6s %10.2f rows/s (random pixels)\n",
+                   names[PIXFMT_RGB16], names[out],
+                   _rows_rate(PIXFMT_RGB16, out, noise, nrows));
+        }
+    }
+
     return 0;
 }
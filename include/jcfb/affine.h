@@ -0,0 +1,53 @@
+/*
+ * Affine transforms
+ *
+ * 2x3 matrices placing bitmaps on others with any combination of
+ * translations, scales, flips, rotations and shears (see
+ * `bitmap_transform_blit()`).
+ */
+#ifndef _jcfb_affine_h_
+#define _jcfb_affine_h_
+
+
+/*
+ * Transform of the point (x, y) to (a * x + b * y + tx,
+ * c * x + d * y + ty).
+ */
+typedef struct affine {
+    float a, b, tx;
+    float c, d, ty;
+} affine_t;
+
+
+/*
+ * Returns the transform leaving points in place.
+ */
+affine_t affine_identity(void);
+
+
+/*
+ * Returns the transform applying `t`, then `u`.
+ */
+affine_t affine_then(affine_t t, affine_t u);
+
+
+/*
+ * Returns `t` followed by a translation of (x, y).
+ */
+affine_t affine_translate(affine_t t, float x, float y);
+
+
+/*
+ * Returns `t` followed by a scale of (sx, sy) around the origin.
+ * Negative factors flip.
+ */
+affine_t affine_scale(affine_t t, float sx, float sy);
+
+
+/*
+ * Returns `t` followed by a rotation of `a` radians around the origin.
+ */
+affine_t affine_rotate(affine_t t, float a);
+
+
+#endif
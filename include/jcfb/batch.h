@@ -0,0 +1,95 @@
+/*
+ * Sprite batches
+ *
+ * A batch queues the blits of a frame on a bitmap and draws them at
+ * once. Sprites are culled and clipped when queued (to the clip
+ * rectangle of the destination at that time), then binned into bands of
+ * rows drawn in parallel on a worker pool (see "jcfb/pool.h"):
+ * each band draws its sprites in submission order, so that overlapping
+ * sprites look like sequential blits.
+ */
+#ifndef _jcfb_batch_h_
+#define _jcfb_batch_h_
+
+
+#include <stdbool.h>
+
+
+#include "jcfb/bitmap.h"
+#include "jcfb/pool.h"
+
+
+/*
+ * Blit operations
+ */
+typedef enum {
+    BATCH_COPY,             /* `bitmap_blit()` */
+    BATCH_MASKED,           /* `bitmap_blit_masked()` */
+    BATCH_BLEND_ADD,        /* `bitmap_blit_blend_add()` */
+    BATCH_ALPHA,            /* `bitmap_blit_alpha()` */
+    BATCH_OP_MAX,
+} batch_op_t;
+
+
+/*
+ * Queued sprite, clipped to the destination
+ */
+typedef struct batch_sprite {
+    bitmap_t src;           /* View of the visible part of the source */
+    int x, y;               /* Position of the view on the destination */
+    batch_op_t op;
+    bool hflip;
+} batch_sprite_t;
+
+
+/*
+ * Sprite batch structure
+ */
+typedef struct batch {
+    bitmap_t* dst;
+    pool_t* pool;           /* NULL to draw on the calling thread */
+    batch_sprite_t* sprites;
+    int count, capacity;
+    int* bins;              /* Sprites of each band, band after band */
+    int bins_capacity;
+} batch_t;
+
+
+/*
+ * Initialize an empty batch of sprites drawn on `dst`, on the threads of
+ * `pool` if not NULL.
+ */
+void batch_init(batch_t* batch, bitmap_t* dst, pool_t* pool);
+
+
+/*
+ * Free the memory of a batch, dropping its queued sprites.
+ */
+void batch_wipe(batch_t* batch);
+
+
+/*
+ * Queue a blit of `src` at (x, y) with operation `op`, flipped on the
+ * x-axis if `hflip`. `src` must stay alive and unchanged until the batch
+ * is drawn. Returns -1 on allocation failure.
+ */
+int batch_add(batch_t* batch, const bitmap_t* src, int x, int y,
+              batch_op_t op, bool hflip);
+
+
+/*
+ * Like `batch_add()`, for the region (sx, sy, sw, sh) of `src`, like a
+ * sprite of a sprite sheet.
+ */
+int batch_add_region(batch_t* batch, const bitmap_t* src,
+                     int sx, int sy, int sw, int sh, int x, int y,
+                     batch_op_t op, bool hflip);
+
+
+/*
+ * Draw the queued sprites, and empty the batch.
+ */
+void batch_draw(batch_t* batch);
+
+
+#endif
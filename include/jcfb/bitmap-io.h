@@ -5,12 +5,30 @@
 #include "jcfb/bitmap.h"
 
 
+/*
+ * Loading options
+ */
+enum {
+    /*
+     * Keep the alpha channel: the bitmap has the PIXFMT_RGBA32 format,
+     * its colors premultiplied by their opacity, for alpha blits.
+     */
+    BITMAP_LOAD_ALPHA = 0x01,
+};
+
+
 /*
  * Load a bitmap from file `path`.
  */
 int bitmap_load(bitmap_t* bmp, const char* path);
 
 
+/*
+ * Like `bitmap_load()`, with a combination of loading options.
+ */
+int bitmap_load_ex(bitmap_t* bmp, const char* path, uint32_t options);
+
+
 /*
  * Save a bitmap in file `path`.
  */
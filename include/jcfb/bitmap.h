@@ -3,8 +3,8 @@
  *
  * Load, create and manipulate bitmaps.
  *
- * Every bliting function assumes given bitmaps have the same pixel
- * format, minus `bitmap_blit()`.
+ * Bliting functions convert the source pixels when the given bitmaps
+ * don't have the same pixel format, which is slower.
  */
 #ifndef _jcfb_bitmap_h_
 #define _jcfb_bitmap_h_
@@ -13,7 +13,9 @@
 #include <stdbool.h>
 
 
+#include "jcfb/affine.h"
 #include "jcfb/pixel.h"
+#include "jcfb/rect.h"
 
 
 /*
@@ -24,20 +26,65 @@ enum {
      * The bitmap owns its memory
      */
     BITMAP_FLAG_MEM_OWNER = 0x01,
+
+    /*
+     * The bitmap owns its damage list
+     */
+    BITMAP_FLAG_DAMAGE_OWNER = 0x02,
+
+    /*
+     * The bitmap owns its palette
+     */
+    BITMAP_FLAG_PALETTE_OWNER = 0x04,
 };
 
 
+/*
+ * Maximal number of clip rectangles saved by `bitmap_push_clip()`.
+ */
+#define BITMAP_CLIP_DEPTH   8
+
+
 /*
  * Bitmap structure
  */
 typedef struct bitmap {
     int w, h;
+    int stride;             /* Pixels between two rows */
+    int psize;              /* Bytes per pixel in memory */
     pixfmt_id_t fmt;
     pixel_t* mem;
     uint32_t flags;
+    rect_list_t* damage;    /* Modified areas, NULL if not tracked */
+    int damage_x, damage_y; /* Offset of the damage, for views */
+    pixel_t* palette;       /* 256 PIXFMT_FB colors of PIXFMT_PAL8 pixels */
+    rect_t clip;            /* Drawable area, inside the bitmap */
+    int clip_depth;
+    rect_t clip_stack[BITMAP_CLIP_DEPTH];
 } bitmap_t;
 
 
+/*
+ * Run of opaque pixels of a row of a RLE sprite.
+ */
+typedef struct bitmap_rle_span {
+    int x, n;               /* First column and length */
+    int offset;             /* Index of the first pixel in `pixels` */
+} bitmap_rle_span_t;
+
+
+/*
+ * RLE sprite: a masked bitmap compiled into the runs of opaque pixels of
+ * its rows (see `bitmap_rle_compile()`).
+ */
+typedef struct bitmap_rle {
+    int w, h;
+    bitmap_t pixels;            /* Pixels of every run, in a single row */
+    bitmap_rle_span_t* spans;   /* Runs, row after row */
+    int* rows;                  /* First run of each row, then their count */
+} bitmap_rle_t;
+
+
 /*
  * Initialize a bitmap having the given dimensions and the PIXFMT_FB
  * pixel format.
@@ -58,6 +105,42 @@ int bitmap_init_from_memory(bitmap_t* bmp, int w, int h, void* mem);
 int bitmap_init_ex(bitmap_t* bmp, pixfmt_id_t fmt, int w, int h);
 
 
+/*
+ * Like `bitmap_init_ex()` but store pixels at the format's depth: 1
+ * byte for PIXFMT_PAL8, 2 bytes for 16 bits formats and 3 bytes for 24
+ * bits ones (other formats use 4 bytes). Packed pixels halve the memory
+ * and bandwidth used by blits and refreshes, but can't hold the mask
+ * color.
+ *
+ * PIXFMT_PAL8 bitmaps hold indexes in a palette of 256 PIXFMT_FB
+ * colors, initially black, that blits expand. Their destinations can be
+ * of any format, but only other PIXFMT_PAL8 bitmaps can be blitted on
+ * them, indexes being copied, and drawing functions take indexes as
+ * colors. They can't be refreshed to the screen.
+ */
+int bitmap_init_packed(bitmap_t* bmp, pixfmt_id_t fmt, int w, int h);
+
+
+/*
+ * Initialize `view` as the (`x`, `y`, `w`, `h`) area of `parent`,
+ * clipped to the parent. The view shares the parent's memory, and
+ * its damage if the parent tracks it when the view is created. Its
+ * clip rectangle is the parent's one, inside the area.
+ * The view must not outlive its parent.
+ * Returns -1 if the area is empty.
+ */
+int bitmap_view(bitmap_t* view, bitmap_t* parent, int x, int y, int w, int h);
+
+
+/*
+ * Set the `n` colors of the palette of a PIXFMT_PAL8 bitmap from index
+ * `first`, which changes every pixel using them (the whole bitmap is
+ * damaged). Views share the palette of their parent.
+ */
+void bitmap_set_palette(bitmap_t* bmp, const pixel_t* colors, int first,
+                        int n);
+
+
 /*
  * Wipe the bitmap's memory.
  */
@@ -65,11 +148,19 @@ void bitmap_wipe(bitmap_t* bmp);
 
 
 /*
- * Returns the address of the given pixel.
+ * Returns the address of the given pixel, for 4 bytes pixels.
  */
 pixel_t* bitmap_pixel_addr(bitmap_t* bmp, int x, int y);
 
 
+/*
+ * Returns the address of the given pixel, whatever its size.
+ */
+static inline void* bitmap_addr(const bitmap_t* bmp, int x, int y) {
+    return (uint8_t*)bmp->mem + ((size_t)y * bmp->stride + x) * bmp->psize;
+}
+
+
 /*
  * Returns the given pixel.
  */
@@ -77,11 +168,56 @@ pixel_t bitmap_pixel(const bitmap_t* bmp, int x, int y);
 
 
 /*
- * Returns the size of the bitmap allocated space in bytes.
+ * Returns the size of the bitmap allocated space in bytes, rows'
+ * padding included.
  */
 size_t bitmap_memsize(const bitmap_t* bmp);
 
 
+/* Clipping --------------------------------------------------------------- */
+/*
+ * Every blit, primitive & text rendering function only draws in the
+ * clip rectangle of the destination bitmap, which is the whole bitmap
+ * once initialized. Clipping is computed once per call, and operations
+ * falling outside the rectangle do nothing (and damage nothing).
+ */
+
+/*
+ * Set the clip rectangle of `bmp` to the (`x`, `y`, `w`, `h`) area,
+ * clipped to the bitmap.
+ */
+void bitmap_set_clip(bitmap_t* bmp, int x, int y, int w, int h);
+
+
+/*
+ * Set the clip rectangle of `bmp` back to the whole bitmap.
+ */
+void bitmap_reset_clip(bitmap_t* bmp);
+
+
+/*
+ * Save the clip rectangle of `bmp`, then restrict it to the
+ * (`x`, `y`, `w`, `h`) area, for example to draw in a panel.
+ * Returns -1 if BITMAP_CLIP_DEPTH rectangles are already saved.
+ */
+int bitmap_push_clip(bitmap_t* bmp, int x, int y, int w, int h);
+
+
+/*
+ * Restore the clip rectangle saved by the last `bitmap_push_clip()`.
+ */
+void bitmap_pop_clip(bitmap_t* bmp);
+
+
+/*
+ * Returns `true` if point (`x`, `y`) is in the clip rectangle of `bmp`.
+ */
+static inline bool bitmap_is_clipped_in(const bitmap_t* bmp, int x, int y) {
+    return x >= bmp->clip.x && x < bmp->clip.x + bmp->clip.w
+        && y >= bmp->clip.y && y < bmp->clip.y + bmp->clip.h;
+}
+
+
 /*
  * Put a RGBA32 pixel at the given coordinates of the bitmap.
  */
@@ -96,7 +232,8 @@ void bitmap_put_pixel_blend_add(bitmap_t* bmp, int x, int y, pixel_t color);
 
 
 /*
- * Clear every pixels of the given bitmap with the given RGBA32 color.
+ * Clear every pixels of the clip rectangle of the given bitmap with the
+ * given RGBA32 color.
  */
 void bitmap_clear(bitmap_t* bmp, pixel_t color);
 
@@ -113,6 +250,30 @@ size_t bitmap_line_size(const bitmap_t* bmp);
 bool bitmap_is_in(const bitmap_t* bmp, int x, int y);
 
 
+/* Damage tracking --------------------------------------------------------- */
+/*
+ * Start (or stop) tracking damage of the given bitmap: every blit,
+ * primitive & text rendering function adds the area it modified to
+ * the bitmap's damage list, which `jcfb_refresh()` uses to only copy
+ * these areas to the framebuffer.
+ * Returns -1 on allocation failure.
+ */
+int bitmap_track_damage(bitmap_t* bmp, bool track);
+
+
+/*
+ * Add the given area to the damage of `bmp`, if it's tracked. Use this
+ * after modifying the bitmap's memory directly.
+ */
+void bitmap_add_damage(bitmap_t* bmp, int x, int y, int w, int h);
+
+
+/*
+ * Forget the damage of `bmp`.
+ */
+void bitmap_clear_damage(bitmap_t* bmp);
+
+
 /* Regular blits ----------------------------------------------------------- */
 /*
  * Blit the `src` bitmap at the given position of `dst` bitmap.
@@ -137,6 +298,25 @@ void bitmap_scaled_region_blit(bitmap_t* dst, const bitmap_t* src,
                                int dx, int dy, int dw, int dh);
 
 
+/*
+ * Like `bitmap_scaled_blit()`, but interpolate the source pixels
+ * (bilinear filtering), which keeps scaled artwork smooth. Halving both
+ * dimensions averages blocks of 2x2 pixels. The mask color is
+ * interpolated like any other, and indexes of PIXFMT_PAL8 destinations
+ * aren't.
+ */
+void bitmap_scaled_blit_filtered(bitmap_t* dst, const bitmap_t* src,
+                                 int x, int y, int w, int h);
+
+
+/*
+ * Like `bitmap_scaled_region_blit()`, with bilinear filtering.
+ */
+void bitmap_scaled_region_blit_filtered(bitmap_t* dst, const bitmap_t* src,
+                                        int sx, int sy, int sw, int sh,
+                                        int dx, int dy, int dw, int dh);
+
+
 /*
  * Blit the `src` bitmap at the given position of `dst` bitmap. Skip
  * masked pixels.
@@ -160,6 +340,66 @@ void bitmap_rotated_blit(bitmap_t* dst, const bitmap_t* src,
                          int cx, int cy, float a);
 
 
+/*
+ * Blit the `src` bitmap transformed by `t`, which maps source
+ * coordinates to `dst` ones: each pixel of `dst` whose center maps
+ * inside `src` takes the source pixel there, in a single pass whatever
+ * the combination of translations, scales, flips and rotations.
+ * Translations by whole pixels, flips and integer scales are as fast as
+ * `bitmap_blit()` and `bitmap_scaled_blit()`. Flat transforms, and ones
+ * with infinite or NaN coefficients, draw nothing.
+ */
+void bitmap_transform_blit(bitmap_t* dst, const bitmap_t* src,
+                           const affine_t* t);
+
+
+/*
+ * Like `bitmap_transform_blit()`, with bilinear filtering.
+ */
+void bitmap_transform_blit_filtered(bitmap_t* dst, const bitmap_t* src,
+                                    const affine_t* t);
+
+
+/*
+ * Like `bitmap_rotated_blit()`, with bilinear filtering (see
+ * `bitmap_scaled_blit_filtered()`).
+ */
+void bitmap_rotated_blit_filtered(bitmap_t* dst, const bitmap_t* src,
+                                  int cx, int cy, float a);
+
+
+/*
+ * Compile `src` into a RLE sprite, leaving out its pixels having the mask
+ * color, and its fully transparent pixels if its format has an alpha
+ * component. RLE blits then copy the remaining runs without testing
+ * pixels, which is much faster than masked blits for sprites having
+ * large transparent areas. The sprite keeps a copy of the palette of
+ * PIXFMT_PAL8 sources. Returns -1 on allocation failure.
+ */
+int bitmap_rle_compile(bitmap_rle_t* rle, const bitmap_t* src);
+
+
+/*
+ * Free the memory of a RLE sprite.
+ */
+void bitmap_rle_wipe(bitmap_rle_t* rle);
+
+
+/*
+ * Blit the runs of `rle` at the given position of `dst`: like
+ * `bitmap_blit_masked()` with the compiled bitmap, less its fully
+ * transparent pixels.
+ */
+void bitmap_rle_blit(bitmap_t* dst, const bitmap_rle_t* rle, int x, int y);
+
+
+/*
+ * Like `bitmap_rle_blit()`, but flip on the x-axis
+ */
+void bitmap_rle_blit_hflip(bitmap_t* dst, const bitmap_rle_t* rle,
+                           int x, int y);
+
+
 /* Additive blend blits ---------------------------------------------------- */
 void bitmap_blit_blend_add(bitmap_t* dst, const bitmap_t* src, int x, int y);
 
@@ -185,6 +425,18 @@ void bitmap_rotated_blit_blend_add(bitmap_t* dst, const bitmap_t* src,
                                    int cx, int cy, float a);
 
 
+void bitmap_transform_blit_blend_add(bitmap_t* dst, const bitmap_t* src,
+                                     const affine_t* t);
+
+
+void bitmap_rle_blit_blend_add(bitmap_t* dst, const bitmap_rle_t* rle,
+                               int x, int y);
+
+
+void bitmap_rle_blit_hflip_blend_add(bitmap_t* dst, const bitmap_rle_t* rle,
+                                     int x, int y);
+
+
 /* Masked blits ------------------------------------------------------------ */
 void bitmap_blit_masked(bitmap_t* dst, const bitmap_t* src, int x, int y);
 
@@ -210,6 +462,49 @@ void bitmap_rotated_blit_masked(bitmap_t* dst, const bitmap_t* src,
                                 int cx, int cy, float a);
 
 
+void bitmap_transform_blit_masked(bitmap_t* dst, const bitmap_t* src,
+                                  const affine_t* t);
+
+
+/* Alpha blits ------------------------------------------------------------- */
+/*
+ * Composite `src` over `dst`. The colors of `src` are premultiplied by
+ * their opacity, and its alpha components hold transparencies (0 is
+ * opaque), like bitmaps loaded with BITMAP_LOAD_ALPHA. Sources without
+ * alpha are opaque.
+ */
+void bitmap_blit_alpha(bitmap_t* dst, const bitmap_t* src, int x, int y);
+
+
+void bitmap_scaled_blit_alpha(bitmap_t* dst, const bitmap_t* src,
+                              int x, int y, int w, int h);
+
+
+void bitmap_scaled_region_blit_alpha(bitmap_t* dst, const bitmap_t* src,
+                                     int sx, int sy, int sw, int sh,
+                                     int dx, int dy, int dw, int dh);
+
+
+void bitmap_blit_hflip_alpha(bitmap_t* dst, const bitmap_t* src,
+                             int x, int y);
+
+
+void bitmap_rotated_blit_alpha(bitmap_t* dst, const bitmap_t* src,
+                               int cx, int cy, float a);
+
+
+void bitmap_transform_blit_alpha(bitmap_t* dst, const bitmap_t* src,
+                                 const affine_t* t);
+
+
+void bitmap_rle_blit_alpha(bitmap_t* dst, const bitmap_rle_t* rle,
+                           int x, int y);
+
+
+void bitmap_rle_blit_hflip_alpha(bitmap_t* dst, const bitmap_rle_t* rle,
+                                 int x, int y);
+
+
 /* ------------------------------------------------------------------------- */
 
 
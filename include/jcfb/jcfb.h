@@ -11,6 +11,7 @@
 #include "jcfb/pixel.h"
 #include "jcfb/bitmap.h"
 #include "jcfb/bitmap-io.h"
+#include "jcfb/batch.h"
 #include "jcfb/primitive.h"
 #include "jcfb/ttf.h"
 #include "jcfb/keyboard.h"
@@ -44,15 +45,136 @@ void jcfb_clear();
 int jcfb_get_bitmap(bitmap_t* bitmap);
 
 
+/*
+ * Initialize `bitmap` as a bitmap drawing directly in the framebuffer
+ * memory, which saves the copy of `jcfb_refresh()`.
+ * Single-buffered, the bitmap is the visible screen and refreshing it
+ * only handles the keyboard. With page flipping, the bitmap is the
+ * hidden page: refreshing it displays it, then moves the bitmap's
+ * memory to the next hidden page, brought up to date with the damaged
+ * areas of the frame (the whole screen if the damage isn't tracked).
+ * It must be initialized again after `jcfb_set_buffering()`, and can't
+ * be used for asynchronous presentation.
+ * On 16 and 24 bits framebuffers, the bitmap's pixels are packed (see
+ * `bitmap_init_packed()`).
+ * Returns -1 if the framebuffer depth isn't 16, 24 or 32 bits.
+ */
+int jcfb_get_direct_bitmap(bitmap_t* bitmap);
+
+
+/*
+ * Set the number of framebuffer pages used to present frames: 1 copies
+ * frames directly into the visible memory, 2 or 3 enable double or
+ * triple buffering. Frames are then rendered in a hidden page of the
+ * framebuffer virtual resolution, which is displayed by panning.
+ * Returns the number of pages actually used, which is 1 if the driver
+ * refuses the virtual resolution or can't pan, or -1 on error.
+ */
+int jcfb_set_buffering(int pages);
+
+
+/*
+ * Enable tile diffing with tiles of `tile_size` pixels, or disable it
+ * if `tile_size` is 0. JCFB then keeps a copy of the frames written to
+ * the framebuffer, compares new frames with it tile by tile, and only
+ * writes the tiles which changed.
+ * It can also be enabled with the JCFB_TILE_DIFF environment variable
+ * (for example JCFB_TILE_DIFF=64).
+ */
+void jcfb_set_tile_diff(int tile_size);
+
+
+/*
+ * Copy frames to the framebuffer with `nthreads` threads, each one
+ * copying a band of rows. The calling thread takes part in the copy, 1
+ * thread disables the workers. If `cpus` isn't NULL, it gives the CPU
+ * each of the `nthreads - 1` workers is pinned to.
+ * It can also be set with the JCFB_THREADS environment variable.
+ * It must not be called during asynchronous presentation.
+ * Returns the number of threads, or -1 if the workers couldn't be
+ * started, in which case a single thread is used. Returns -1 without
+ * changing anything if JCFB isn't started, or if a CPU isn't online.
+ */
+int jcfb_set_threads(int nthreads, const int* cpus);
+
+
 /*
  * Refresh the screen with the given bitmap. This bitmap need to have
  * the framebuffer dimensions and pxiel format. Use `jcfb_get_bitmap()`
  * to retrieve such bitmap.
+ * If the bitmap tracks its damage (see `bitmap_track_damage()`), only
+ * the damaged areas are copied, and the damage is cleared.
  * Update keyboard & mouse state.
  */
 void jcfb_refresh(bitmap_t* bmp);
 
 
+/*
+ * Wait for the next vertical blank of the display.
+ * Without vblank support from the driver, sleep until the next period
+ * of a schedule following the display refresh rate.
+ * Returns 0 on a driver vblank, 1 on a scheduled one, -1 if
+ * interrupted.
+ */
+int jcfb_wait_vsync();
+
+
+/*
+ * Like `jcfb_refresh()`, but paced to present a frame every
+ * `interval_us` microseconds, or on every vertical blank if
+ * `interval_us` is 0. Call it once the frame is rendered: it sleeps
+ * until the next deadline instead of busy-looping.
+ * Returns the number of deadlines missed since the previous frame.
+ */
+int jcfb_present(bitmap_t* bmp, long interval_us);
+
+
+/*
+ * Presentation statistics.
+ */
+typedef struct jcfb_stats {
+    unsigned long frames;  /* Frames presented by `jcfb_present()` */
+    unsigned long missed;  /* Total missed deadlines */
+    long frame_us;         /* Time between the two last frames */
+    unsigned long tiles;          /* Tiles compared by the last refresh */
+    unsigned long tiles_written;  /* Tiles it wrote to the framebuffer */
+} jcfb_stats_t;
+
+
+/*
+ * Retrieve presentation statistics.
+ */
+void jcfb_get_stats(jcfb_stats_t* stats);
+
+
+/*
+ * Start presenting frames from a dedicated thread, so that the next
+ * frame can be rendered while the previous one is copied to the
+ * framebuffer. Frames are paced like with `jcfb_present()`, unless
+ * `interval_us` is negative.
+ * Returns the first bitmap to render in, or NULL on error.
+ * Don't call `jcfb_refresh()` or `jcfb_present()` until
+ * `jcfb_async_stop()` is called.
+ */
+bitmap_t* jcfb_async_start(long interval_us);
+
+
+/*
+ * Hand over the rendered bitmap `bmp` to the presenter thread, and
+ * returns the bitmap to render the next frame in, once the presenter
+ * is done with it. This bitmap contains the frame handed over two
+ * calls before. Update keyboard state.
+ */
+bitmap_t* jcfb_async_present(bitmap_t* bmp);
+
+
+/*
+ * Stop the presenter thread once it has presented the last frame handed
+ * over, and free its bitmaps.
+ */
+void jcfb_async_stop();
+
+
 /*
  * Get the framebuffer width.
  */
@@ -23,6 +23,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 /*
@@ -47,7 +48,9 @@ typedef enum {
     PIXFMT_BGR24,
     PIXFMT_RGBA32,
     PIXFMT_ARGB32,
-    PIXFMT_ABGR32
+    PIXFMT_ABGR32,
+    PIXFMT_PAL8,        /* Indexes in a palette of PIXFMT_FB colors */
+    PIXFMT_MAX,
 } pixfmt_id_t;
 
 
@@ -107,6 +110,62 @@ pixel_t pixel_to(pixfmt_id_t fmt, pixel_t rgba32);
 pixel_t pixel_conv(pixfmt_id_t in_fmt, pixfmt_id_t out_fmt, pixel_t p);
 
 
+/*
+ * Pixel conversion plan
+ *
+ * Conversion from one format to another, precomputed once per pair of
+ * formats: each component is masked in the source pixel, then shifted
+ * in place. `row` is a converter specialized for the pair and the
+ * kernels selected by the SIMD module (see "jcfb/simd.h").
+ */
+typedef struct pixconv_plan {
+    pixfmt_id_t in_fmt, out_fmt;
+    uint32_t masks[COMP_MAX];   /* Kept bits of each source component */
+    uint32_t lshifts[COMP_MAX];
+    uint32_t rshifts[COMP_MAX];
+    bool bytewise;              /* Only moves whole bytes */
+    int8_t bytes[4];            /* Source byte of each byte, -1 for 0 */
+    void (*row)(const struct pixconv_plan* plan, pixel_t* dst,
+                const pixel_t* src, int n);
+} pixconv_plan_t;
+
+
+/*
+ * Row converter of a plan
+ */
+typedef void (*pixconv_row_func_t)(const pixconv_plan_t* plan, pixel_t* dst,
+                                   const pixel_t* src, int n);
+
+
+/*
+ * Returns the conversion plan from `in_fmt` to `out_fmt`.
+ */
+const pixconv_plan_t* pixconv_plan_get(pixfmt_id_t in_fmt,
+                                       pixfmt_id_t out_fmt);
+
+
+/*
+ * Convert a pixel with the given plan.
+ */
+static inline pixel_t pixconv_plan_pixel(const pixconv_plan_t* plan,
+                                         pixel_t p)
+{
+    pixel_t out = 0;
+    for (int i = 0; i < COMP_MAX; i++) {
+        out |= ((p & plan->masks[i]) << plan->lshifts[i])
+             >> plan->rshifts[i];
+    }
+    return out;
+}
+
+
+/*
+ * Convert `n` pixels from `in_fmt` to `out_fmt`. `dst` may be `src`.
+ */
+void pixel_convert_row(pixfmt_id_t in_fmt, pixfmt_id_t out_fmt,
+                       pixel_t* dst, const pixel_t* src, int n);
+
+
 /*
  * Create a pixel in the framebuffer format using the given RGB
  * components.
@@ -144,4 +203,78 @@ pixel_t get_mask_color();
 pixel_t pixel_blend_add(pixel_t src, pixel_t dst);
 
 
+/*
+ * Add the `n` pixels of `src` on the `n` pixels of `dst`.
+ */
+void pixel_blend_add_row(pixel_t* dst, const pixel_t* src, int n);
+
+
+/*
+ * Add `color` on the `n` pixels of `dst`.
+ */
+void pixel_blend_add_fill(pixel_t* dst, pixel_t color, int n);
+
+
+/*
+ * Composite the `n` pixels of `src` over the `n` pixels of `dst`,
+ * `plan` converting from the source format to the destination one.
+ * Source colors are premultiplied by their opacity, and, as everywhere
+ * in JCFB, alpha components are transparencies (0 is opaque). Sources
+ * without alpha are opaque.
+ */
+void pixel_blend_over_row(const pixconv_plan_t* plan, pixel_t* dst,
+                          const pixel_t* src, int n);
+
+
+/*
+ * Read a pixel stored on `psize` bytes (1, 2, 3 or 4) at `addr`.
+ * Packed pixels are the low bytes of the pixel value.
+ */
+static inline pixel_t pixel_load(const void* addr, int psize) {
+    const uint8_t* p = addr;
+    switch (psize) {
+      case 1:
+        return p[0];
+      case 2: {
+        uint16_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+      }
+      case 3:
+        return p[0] | p[1] << 8 | p[2] << 16;
+      default: {
+        pixel_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+      }
+    }
+}
+
+
+/*
+ * Store pixel `v` on `psize` bytes (1, 2, 3 or 4) at `addr`.
+ */
+static inline void pixel_store(void* addr, int psize, pixel_t v) {
+    uint8_t* p = addr;
+    switch (psize) {
+      case 1:
+        p[0] = v;
+        break;
+      case 2: {
+        uint16_t v16 = v;
+        memcpy(p, &v16, sizeof(v16));
+        break;
+      }
+      case 3:
+        p[0] = v;
+        p[1] = v >> 8;
+        p[2] = v >> 16;
+        break;
+      default:
+        memcpy(p, &v, sizeof(v));
+        break;
+    }
+}
+
+
 #endif
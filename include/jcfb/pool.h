@@ -0,0 +1,65 @@
+/*
+ * Worker pool
+ *
+ * A small pool of persistent threads running jobs in parallel. The
+ * thread calling `pool_run()` takes part in the work, so a pool of `n`
+ * threads starts `n - 1` workers, and a pool of one thread runs every
+ * job on the calling thread.
+ */
+#ifndef _jcfb_pool_h_
+#define _jcfb_pool_h_
+
+
+#include <pthread.h>
+#include <stdbool.h>
+
+
+/*
+ * Job function, called once for every job index in [0, njobs[.
+ */
+typedef void (*pool_func_t)(void* arg, int job);
+
+
+/*
+ * Worker pool structure
+ */
+typedef struct pool {
+    int nthreads;
+    pthread_t* workers;
+    pthread_mutex_t lock;
+    pthread_cond_t start;   /* Signaled when a run starts */
+    pthread_cond_t done;    /* Signaled when a run's jobs are done */
+
+    pool_func_t func;
+    void* arg;
+    int njobs;
+    int next_job;
+    int pending;            /* Jobs not yet finished */
+    unsigned generation;    /* Incremented on each run */
+    bool quit;
+} pool_t;
+
+
+/*
+ * Initialize a pool of `nthreads` threads.
+ * If `cpus` isn't NULL, it gives the CPU index each of the
+ * `nthreads - 1` worker threads is pinned to.
+ * Returns -1 on failure.
+ */
+int pool_init(pool_t* pool, int nthreads, const int* cpus);
+
+
+/*
+ * Stop the pool's workers.
+ */
+void pool_wipe(pool_t* pool);
+
+
+/*
+ * Run `func(arg, job)` for every job in [0, njobs[ on the pool's
+ * threads, and return once every job is done.
+ */
+void pool_run(pool_t* pool, pool_func_t func, void* arg, int njobs);
+
+
+#endif
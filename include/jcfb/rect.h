@@ -0,0 +1,77 @@
+/*
+ * Rectangles
+ *
+ * Rectangles & rectangle lists, used to describe areas of bitmaps, like
+ * the damaged area of a bitmap which needs to be refreshed.
+ */
+#ifndef _jcfb_rect_h_
+#define _jcfb_rect_h_
+
+
+#include <stdbool.h>
+
+
+/*
+ * Maximal number of rectangles in a rectangle list.
+ */
+#define RECT_LIST_MAX   32
+
+
+/*
+ * Rectangle of top-left corner (x, y) and dimensions (w, h).
+ */
+typedef struct rect {
+    int x, y, w, h;
+} rect_t;
+
+
+/*
+ * Rectangle list
+ */
+typedef struct rect_list {
+    int count;
+    rect_t rects[RECT_LIST_MAX];
+} rect_list_t;
+
+
+/*
+ * Returns true if the given rectangle has no area.
+ */
+bool rect_is_empty(rect_t r);
+
+
+/*
+ * Returns true if `r` is inside `in`.
+ */
+bool rect_contains(rect_t in, rect_t r);
+
+
+/*
+ * Returns the intersection of both rectangles.
+ */
+rect_t rect_intersect(rect_t a, rect_t b);
+
+
+/*
+ * Returns the smallest rectangle containing both rectangles.
+ */
+rect_t rect_union(rect_t a, rect_t b);
+
+
+/*
+ * Add rectangle `r` to the list. Empty or already covered rectangles
+ * are ignored. If the list is full, rectangles are merged, and `r` is
+ * merged with the rectangle whose area grows the least if that isn't
+ * enough.
+ */
+void rect_list_add(rect_list_t* list, rect_t r);
+
+
+/*
+ * Merge rectangles of the list as long as a merge doesn't cover much
+ * more area than the merged rectangles do.
+ */
+void rect_list_merge(rect_list_t* list);
+
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Scanout module
+ *
+ * Kernels copying a bitmap into framebuffer memory.
+ *
+ * Bitmaps store their pixels on 32 bits, or packed on `psize` bytes
+ * (see doc/rendering.txt), while the framebuffer memory has its own
+ * depth and line length. Each kernel is specialized for one framebuffer
+ * layout, and `jcfb_start()` selects the best one once with
+ * `scanout_init()`. Packed bitmaps are copied row by row when stored at
+ * the framebuffer depth, pixel by pixel otherwise.
+ *
+ * Every kernel copies a rectangle of the source bitmap at the same
+ * position in the target memory. The rectangle must already be clipped
+ * to both the bitmap and the target dimensions.
+ */
+#ifndef _jcfb_scanout_h_
+#define _jcfb_scanout_h_
+
+
+#include <stddef.h>
+
+
+#include "jcfb/bitmap.h"
+#include "jcfb/pool.h"
+
+
+/*
+ * Scanout kernels
+ */
+typedef enum {
+    SCANOUT_GENERIC = 0,  /* Per-pixel copy, any depth */
+    SCANOUT_BULK32,       /* 32bpp, unpadded lines, one copy per frame */
+    SCANOUT_ROWS32,       /* 32bpp, padded lines, one copy per row */
+    SCANOUT_PACK24,       /* 24bpp, packs 4 bytes pixels on 3 bytes */
+    SCANOUT_PACK16,       /* 16bpp, packs 4 bytes pixels on 2 bytes */
+    SCANOUT_MAX,
+} scanout_id_t;
+
+
+/*
+ * Scanout target description & selected kernel.
+ */
+typedef struct scanout {
+    scanout_id_t id;
+    size_t bpp;          /* Target bytes per pixel */
+    size_t line_length;  /* Target bytes between two lines */
+    void (*func)(const struct scanout* so, void* dst,
+                 const bitmap_t* src, int x, int y, int w, int h);
+} scanout_t;
+
+
+/*
+ * Select the fastest kernel able to write `w` pixels wide lines in a
+ * memory of `bits_per_pixel` depth and `line_length` bytes per line.
+ */
+int scanout_init(scanout_t* so, size_t bits_per_pixel, size_t line_length,
+                 int w);
+
+
+/*
+ * Like `scanout_init()` but force kernel `id`.
+ * Returns -1 if that kernel can't handle the given memory layout.
+ */
+int scanout_init_ex(scanout_t* so, scanout_id_t id,
+                    size_t bits_per_pixel, size_t line_length, int w);
+
+
+/*
+ * Copy the given rectangle of `src` to `dst` memory.
+ */
+void scanout_copy(const scanout_t* so, void* dst, const bitmap_t* src,
+                  int x, int y, int w, int h);
+
+
+/*
+ * Like `scanout_copy()` but split the rectangle in row bands copied in
+ * parallel on the threads of `pool`.
+ */
+void scanout_copy_pool(const scanout_t* so, pool_t* pool, void* dst,
+                       const bitmap_t* src, int x, int y, int w, int h);
+
+
+/*
+ * Returns a printable name of the given kernel.
+ */
+const char* scanout_name(scanout_id_t id);
+
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ * SIMD module
+ *
+ * Runtime selection of the row kernels of pixel operations.
+ *
+ * The CPU features are detected once, by `jcfb_start()` or on first
+ * use, and the fastest instruction set they support fills a table with
+ * the kernel of every operation, so that one binary runs at its best on
+ * every generation of x86 and ARM CPUs. The JCFB_SIMD environment
+ * variable ("scalar", "sse2", "ssse3", "avx2", "neon") or
+ * `simd_set_level()` pins another instruction set, to compare kernels
+ * or to reproduce a bug.
+ */
+#ifndef _jcfb_simd_h_
+#define _jcfb_simd_h_
+
+
+#include <stdbool.h>
+
+
+#include "jcfb/pixel.h"
+
+
+/*
+ * Instruction sets
+ */
+typedef enum {
+    SIMD_SCALAR = 0,
+    SIMD_SSE2,
+    SIMD_SSSE3,         /* Byte shuffles */
+    SIMD_AVX2,
+    SIMD_NEON,
+    SIMD_LEVEL_MAX,
+} simd_level_t;
+
+
+/*
+ * Size in bytes of the map of `_n` columns of `scale_lerp`.
+ */
+#define SIMD_LERP_MAP_SIZE(_n) ((size_t)(_n) / 8 * 132)
+
+
+/*
+ * Row kernels of the selected instruction set
+ *
+ * Every kernel works on `n` contiguous 32 bits pixels. Blending kernels
+ * read a source pixel every `sstep` pixels (0 repeats the first one).
+ */
+typedef struct simd_kernels {
+    simd_level_t level;
+
+    /* Fill with `color` */
+    void (*clear)(pixel_t* dst, pixel_t color, int n);
+
+    /* Copy from `src` */
+    void (*copy)(pixel_t* dst, const pixel_t* src, int n);
+
+    /* Copy the pixels of `src` which aren't `mask` */
+    void (*mask)(pixel_t* dst, const pixel_t* src, pixel_t mask, int n);
+
+    /* Copy `src[cols[i]]` to `dst[i]` */
+    void (*scale)(pixel_t* dst, const pixel_t* src, const int* cols, int n);
+
+    /* Interpolate the 8 bits components of `a` and `b`, `b` weighing
+     * `t / 256` */
+    void (*lerp)(pixel_t* dst, const pixel_t* a, const pixel_t* b, int t,
+                 int n);
+
+    /* Interpolate `src[cols[i]]` and the pixel after it, which weighs
+     * `w[i] / 256`, `cols` not decreasing, `map` being prepared for them
+     * by `scale_lerp_map` */
+    void (*scale_lerp)(pixel_t* dst, const pixel_t* src, const int* cols,
+                       const uint8_t* w, const void* map, int n);
+
+    /* Prepare the `map` of `scale_lerp`, of SIMD_LERP_MAP_SIZE(n)
+     * bytes, once for all the rows scaled by the same columns. NULL when
+     * the kernels need none */
+    void (*scale_lerp_map)(void* map, const int* cols, const uint8_t* w,
+                           int n);
+
+    /* Average the 8 bits components of the 2x2 blocks of 2n pixels rows
+     * `a` and `b` */
+    void (*box)(pixel_t* dst, const pixel_t* a, const pixel_t* b, int n);
+
+    /* Conversions by masks and shifts, and by byte moves */
+    pixconv_row_func_t convert;
+    pixconv_row_func_t convert_bytes;
+
+    /* Saturated additions of 8 bits components, and of other ones */
+    void (*blend_bytes)(pixel_t* dst, const pixel_t* src, int sstep, int n);
+    void (*blend_fields)(pixel_t* dst, const pixel_t* src, int sstep, int n);
+
+    /* Compositing of the 8 bits components of `conv`, `src` converted */
+    void (*over_bytes)(const pixconv_plan_t* plan, pixel_t* dst,
+                       const pixel_t* src, const pixel_t* conv, int n);
+} simd_kernels_t;
+
+
+/*
+ * Detect the CPU features and select the kernels, if not done yet.
+ */
+void simd_init();
+
+
+/*
+ * Returns the kernels of the selected instruction set.
+ */
+const simd_kernels_t* simd_kernels();
+
+
+/*
+ * Select the kernels of `level`.
+ * Returns -1 if the CPU doesn't support it.
+ */
+int simd_set_level(simd_level_t level);
+
+
+/*
+ * Returns the selected instruction set.
+ */
+simd_level_t simd_get_level();
+
+
+/*
+ * Returns `true` if the CPU supports `level`.
+ */
+bool simd_supported(simd_level_t level);
+
+
+/*
+ * Returns `true` if the kernels of `level` may be used with the
+ * selected instruction set, x86 ones including the older ones.
+ */
+bool simd_has(simd_level_t level);
+
+
+/*
+ * Returns a printable name of the given instruction set.
+ */
+const char* simd_level_name(simd_level_t level);
+
+
+#endif
@@ -197,8 +197,12 @@ int main(int argc, char** argv) {
     }
 
     srand(time(NULL));
-    bitmap_t buffer;
-    jcfb_get_bitmap(&buffer);
+    // Render the next frame while the previous one is presented.
+    bitmap_t* buffer = jcfb_async_start(1000000 / 60);
+    if (!buffer) {
+        fprintf(stderr, "Cannot start the presenter thread\n");
+        return 1;
+    }
 
     int width = jcfb_width();
     int height = jcfb_height();
@@ -212,20 +216,19 @@ int main(int argc, char** argv) {
             feed(&fw, width, height);
         }
 
-        bitmap_clear(&buffer, 0);
+        bitmap_clear(buffer, 0);
         firework_update(&fw);
-        firework_render(&buffer, &fw);
+        firework_render(buffer, &fw);
         if (is_key_pressed(KEYC_ESC)) {
             exit = 1;
         }
         if (is_key_pressed(KEYC_ENTER)) {
             feed(&fw, width, height);
         }
-        jcfb_refresh(&buffer);
-        usleep(1E6 / 60);
+        buffer = jcfb_async_present(buffer);
     }
 
-    bitmap_wipe(&buffer);
+    jcfb_async_stop();
     jcfb_stop();
     return 0;
 }
@@ -2,6 +2,9 @@
  * Mandelbrot
  *
  * Display the mandelbrot fractal using the framebuffer.
+ *
+ * The fractal is rendered once in a PIXFMT_PAL8 bitmap, whose palette
+ * is then cycled every frame.
  */
 #include <math.h>
 #include <stdio.h>
@@ -126,23 +129,33 @@ static void do_palette(pixel_t* colors, int size) {
     int (*gfunc)(int, int) = color_funcs[rand() % 5];
 
     for (int i = 0; i < size; i++) {
-        colors[i] = rfunc(i, size)
-                  | (gfunc(i, size) << 8)
-                  | (bfunc(i, size) << 16);
+        colors[i] = pixel(rfunc(i, size)
+                        | (gfunc(i, size) << 8)
+                        | (bfunc(i, size) << 16));
     }
 }
 
 
-void draw(bitmap_t* bmp, const int* iterations, int it_max) {
-    pixel_t palette[it_max];
-    float k = it_max / log(it_max + 1);
+// Set the palette of `image` to `colors` rotated by `offset` entries.
+static void cycle_palette(bitmap_t* image, const pixel_t* colors, int size,
+                          int offset)
+{
+    pixel_t cycled[size];
+    for (int i = 0; i < size; i++) {
+        cycled[i] = colors[(i + offset) % size];
+    }
+    bitmap_set_palette(image, cycled, 0, size);
+}
+
 
-    do_palette(palette, it_max);
+// Draw palette indexes, the colors are only looked up when blitting.
+void draw(bitmap_t* image, const int* iterations, int it_max) {
+    float k = it_max / log(it_max + 1);
 
-    for (int yi = 0; yi < bmp->h; yi++) {
-        for (int xi = 0; xi < bmp->w; xi++) {
-            int it = iterations[yi * bmp->w + xi];
-            bitmap_put_pixel(bmp, xi, yi, pixel(palette[(int)(k * log(it))]));
+    for (int yi = 0; yi < image->h; yi++) {
+        for (int xi = 0; xi < image->w; xi++) {
+            int it = iterations[yi * image->w + xi];
+            bitmap_put_pixel(image, xi, yi, k * log(it));
         }
     }
 }
@@ -162,25 +175,37 @@ int main(int argc, char** argv) {
     int width = jcfb_width();
     int height = jcfb_height();
     int* iterations = malloc(width * height * sizeof(int));
+    bitmap_t image;
+    if (bitmap_init_packed(&image, PIXFMT_PAL8, width, height) != 0) {
+        fprintf(stderr, "Cannot allocate the image\n");
+        return 1;
+    }
+    pixel_t colors[256];
 
     int nit = 1 + rand() % 100;
     generate(width, height, iterations, nit);
-    draw(&buffer, iterations, nit);
+    draw(&image, iterations, nit);
+    do_palette(colors, nit);
 
     int exit = 0;
-    while (!exit) {
+    for (int frame = 0; !exit; frame++) {
         if (is_key_pressed(KEYC_ESC)) {
             exit = 1;
         }
         if (is_key_pressed(KEYC_ENTER)) {
             nit = 1 + rand() % 100;
             generate(width, height, iterations, nit);
-            draw(&buffer, iterations, nit);
+            draw(&image, iterations, nit);
+            do_palette(colors, nit);
         }
+        cycle_palette(&image, colors, nit, frame);
+        bitmap_blit(&buffer, &image, 0, 0);
         jcfb_refresh(&buffer);
         usleep(1E6 / 30);
     }
 
+    bitmap_wipe(&image);
+    free(iterations);
     bitmap_wipe(&buffer);
     jcfb_stop();
     return 0;
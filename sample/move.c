@@ -14,14 +14,12 @@ int main(int argc, char** argv) {
         fprintf(stderr, "Cannot start JCFB\n");
         return 1;
     }
+    jcfb_set_buffering(2);
 
     bitmap_t screen;
     jcfb_get_bitmap(&screen);
     bitmap_clear(&screen, 0x00000000);
 
-    bitmap_t buffer;
-    bitmap_init(&buffer, 640, 400);
-
     bitmap_t player;
     if (bitmap_load(&player, "data/player.bmp") != 0) {
         return 1;
@@ -47,19 +45,19 @@ int main(int argc, char** argv) {
         if (is_key_pressed(KEYC_RIGHT)) {
             player_x += 16;
         }
-        bitmap_clear(&buffer, 0x00000000);
-        bitmap_rotated_blit_masked(
-            &buffer, &player,
-            player_x, player_y, angle);
-        bitmap_scaled_blit(&screen, &buffer, 0, 0,
-                           screen.w, screen.h);
-        jcfb_refresh(&screen);
-        usleep(1000);
+        // The player moves on a 640x400 area stretched to the screen.
+        affine_t t = affine_translate(affine_identity(),
+                                      -(player.w / 2), -(player.h / 2));
+        t = affine_rotate(t, angle);
+        t = affine_translate(t, player_x, player_y);
+        t = affine_scale(t, screen.w / 640.0f, screen.h / 400.0f);
+        bitmap_clear(&screen, 0x00000000);
+        bitmap_transform_blit_masked(&screen, &player, &t);
+        jcfb_present(&screen, 0);
         angle += 0.01f;
     }
 
     bitmap_wipe(&player);
-    bitmap_wipe(&buffer);
     bitmap_wipe(&screen);
 
     jcfb_stop();
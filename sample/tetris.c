@@ -384,20 +384,23 @@ void draw_tile(bitmap_t* bmp, int x, int y, tetrimino_id_t id) {
         // Don't draw tiles on first two lines.
         return;
     }
-    float res_w = bmp->w / (float)BOARD_WIDTH;
-    float res_h = bmp->h / (float)(BOARD_HEIGHT - 2);
+    // The board is the clip rectangle.
+    rect_t board = bmp->clip;
+    float res_w = board.w / (float)BOARD_WIDTH;
+    float res_h = board.h / (float)(BOARD_HEIGHT - 2);
 
-    int x1 = x * res_w + 1;
-    int x2 = (x + 1) * res_w - 1;
-    int y1 = (y - 2) * res_h + 1;   // -2 is to adapt coordinates
-    int y2 = (y - 1) * res_h - 1;
+    int x1 = board.x + x * res_w + 1;
+    int x2 = board.x + (x + 1) * res_w - 1;
+    int y1 = board.y + (y - 2) * res_h + 1;   // -2 is to adapt coordinates
+    int y2 = board.y + (y - 1) * res_h - 1;
 
     fill_rect(bmp, pixel(tetrimino_colors[id]), x1, y1, x2, y2);
 }
 
 
+// Draw the board in the clip rectangle of `bmp`.
 void draw_game(bitmap_t* bmp) {
-    bitmap_clear(bmp, 0x00000000); 
+    bitmap_clear(bmp, 0x00000000);
     for (int y = 2; y < BOARD_HEIGHT; y++) {
         for (int x = 0; x < BOARD_WIDTH; x++) {
             tetrimino_id_t id = _G.board[y * BOARD_WIDTH + x];
@@ -429,14 +432,30 @@ int main(int argc, char** argv) {
 
     bitmap_t buffer;
     jcfb_get_bitmap(&buffer);
-    bitmap_t board;
-    bitmap_init(&board, buffer.h / 2, buffer.h - 1);
+    // The board is drawn straight in the buffer, clipped to its panel.
+    rect_t board = {buffer.w / 2 - buffer.h / 4, 0, buffer.h / 2,
+                    buffer.h - 1};
 
     ttf_font_t font;
     if (ttf_load(&font, "data/Hermit-light.otf") < 0) {
         goto error;
     }
 
+    // Only redraw what changes, and let the refresh copy just that.
+    bitmap_track_damage(&buffer, true);
+    bitmap_clear(&buffer, 0x00000000);
+    draw_vline(&buffer, pixel(0x00ffffff),
+               buffer.w / 2 - board.w / 2 - 1,
+               0, buffer.h);
+    draw_vline(&buffer, pixel(0x00ffffff),
+               buffer.w / 2 + board.w / 2 + 1,
+               0, buffer.h);
+    draw_hline(&buffer, pixel(0x00ffffff),
+               buffer.w / 2 - board.w / 2,
+               buffer.w / 2 + board.w / 2 + 1,
+               buffer.h - 1);
+    int text_x = buffer.w / 2 + board.w / 2 + 10;
+
     start_game();
     int exit = 0;
     while (!exit) {
@@ -457,36 +476,22 @@ int main(int argc, char** argv) {
         }
         loop_game();
 
-        bitmap_clear(&buffer, 0x00000000);
-        draw_vline(&buffer, pixel(0x00ffffff),
-                   buffer.w / 2 - board.w / 2 - 1,
-                   0, buffer.h);
-        draw_vline(&buffer, pixel(0x00ffffff),
-                   buffer.w / 2 + board.w / 2 + 1,
-                   0, buffer.h);
-        draw_hline(&buffer, pixel(0x00ffffff),
-                   buffer.w / 2 - board.w / 2,
-                   buffer.w / 2 + board.w / 2 + 1,
-                   buffer.h - 1);
-
-        draw_game(&board);
-        bitmap_blit(&buffer, &board, buffer.w / 2 - board.w / 2, 0);
+        bitmap_push_clip(&buffer, board.x, board.y, board.w, board.h);
+        draw_game(&buffer);
+        bitmap_pop_clip(&buffer);
 
         char str_buffer[256];
+        fill_rect(&buffer, 0x00000000, text_x, 0, buffer.w - 1, 80);
         sprintf(str_buffer, "Level %d", _G.level);
-        ttf_render(&font, str_buffer, &buffer,
-                   buffer.w / 2 + board.w / 2 + 10,
+        ttf_render(&font, str_buffer, &buffer, text_x,
                    24, 24, 0x0055cc22);
         sprintf(str_buffer, "Score %d", _G.score);
-        ttf_render(&font, str_buffer, &buffer,
-                   buffer.w / 2 + board.w / 2 + 10,
+        ttf_render(&font, str_buffer, &buffer, text_x,
                    48, 24, 0x00cc5500);
 
-        jcfb_refresh(&buffer);
-        usleep(1E6 / 30);
+        jcfb_present(&buffer, 1000000 / 30);
     }
 
-    bitmap_wipe(&board);
     bitmap_wipe(&buffer);
     ttf_wipe(&font);
     jcfb_stop();
@@ -0,0 +1,39 @@
+#include <math.h>
+
+
+#include "jcfb/affine.h"
+
+
+affine_t affine_identity(void) {
+    return (affine_t){1, 0, 0, 0, 1, 0};
+}
+
+
+affine_t affine_then(affine_t t, affine_t u) {
+    return (affine_t){
+        .a = u.a * t.a + u.b * t.c,
+        .b = u.a * t.b + u.b * t.d,
+        .tx = u.a * t.tx + u.b * t.ty + u.tx,
+        .c = u.c * t.a + u.d * t.c,
+        .d = u.c * t.b + u.d * t.d,
+        .ty = u.c * t.tx + u.d * t.ty + u.ty,
+    };
+}
+
+
+affine_t affine_translate(affine_t t, float x, float y) {
+    t.tx += x;
+    t.ty += y;
+    return t;
+}
+
+
+affine_t affine_scale(affine_t t, float sx, float sy) {
+    return affine_then(t, (affine_t){sx, 0, 0, 0, sy, 0});
+}
+
+
+affine_t affine_rotate(affine_t t, float a) {
+    float c = cosf(a), s = sinf(a);
+    return affine_then(t, (affine_t){c, -s, 0, s, c, 0});
+}
@@ -0,0 +1,317 @@
+#include <stdlib.h>
+#include <string.h>
+
+
+#include "jcfb/batch.h"
+#include "jcfb/simd.h"
+#include "jcfb/util.h"
+
+
+// Bands are at least this high, and there are a few of them per thread
+// so that threads drawing sparse bands help the others.
+#define BAND_MIN_H          16
+#define BANDS_PER_THREAD    4
+
+
+typedef void (*_blit_func_t)(bitmap_t*, const bitmap_t*, int, int);
+
+
+static const _blit_func_t _BLITS[BATCH_OP_MAX][2] = {
+    [BATCH_COPY] = {bitmap_blit, bitmap_blit_hflip},
+    [BATCH_MASKED] = {bitmap_blit_masked, bitmap_blit_hflip_masked},
+    [BATCH_BLEND_ADD] = {bitmap_blit_blend_add, bitmap_blit_hflip_blend_add},
+    [BATCH_ALPHA] = {bitmap_blit_alpha, bitmap_blit_hflip_alpha},
+};
+
+
+void batch_init(batch_t* batch, bitmap_t* dst, pool_t* pool) {
+    *batch = (batch_t){
+        .dst = dst,
+        .pool = pool,
+    };
+}
+
+
+void batch_wipe(batch_t* batch) {
+    free(batch->sprites);
+    free(batch->bins);
+    batch->sprites = NULL;
+    batch->bins = NULL;
+    batch->count = batch->capacity = batch->bins_capacity = 0;
+}
+
+
+int batch_add(batch_t* batch, const bitmap_t* src, int x, int y,
+              batch_op_t op, bool hflip)
+{
+    return batch_add_region(batch, src, 0, 0, src->w, src->h, x, y, op,
+                            hflip);
+}
+
+
+int batch_add_region(batch_t* batch, const bitmap_t* src,
+                     int sx, int sy, int sw, int sh, int x, int y,
+                     batch_op_t op, bool hflip)
+{
+    // The region is clipped to the source, moving what's left of it
+    // where it would have been drawn (a flip mirrors its horizontal
+    // clipping), then to the clip rectangle of the destination.
+    rect_t s = rect_intersect((rect_t){sx, sy, sw, sh},
+                              (rect_t){0, 0, src->w, src->h});
+    x += hflip ? sx + sw - (s.x + s.w) : s.x - sx;
+    y += s.y - sy;
+    rect_t d = rect_intersect((rect_t){x, y, s.w, s.h}, batch->dst->clip);
+    if (rect_is_empty(d) || op < 0 || op >= BATCH_OP_MAX) {
+        return 0;
+    }
+    int left = hflip ? x + s.w - (d.x + d.w) : d.x - x;
+
+    if (batch->count == batch->capacity) {
+        int capacity = max(64, batch->capacity * 2);
+        batch_sprite_t* sprites = realloc(batch->sprites,
+                                          capacity * sizeof(*sprites));
+        if (!sprites) {
+            return -1;
+        }
+        batch->sprites = sprites;
+        batch->capacity = capacity;
+    }
+    batch_sprite_t* sprite = &batch->sprites[batch->count++];
+    *sprite = (batch_sprite_t){
+        .x = d.x,
+        .y = d.y,
+        .op = op,
+        .hflip = hflip,
+    };
+    bitmap_view(&sprite->src, (bitmap_t*)src, s.x + left, s.y + d.y - y,
+                d.w, d.h);
+    return 0;
+}
+
+
+typedef struct {
+    const batch_t* batch;
+    const int* starts;      /* First bin of each band, then their count */
+    int band_h;
+} _band_job_t;
+
+
+// Draw the sprites of band `job` in a view of it, whose damage is added
+// once the bands are drawn. Sprites were clipped when queued, so the
+// view doesn't inherit the current clip rectangle of the destination.
+static void _draw_band(void* arg, int job) {
+    const _band_job_t* b = arg;
+    const batch_t* batch = b->batch;
+    int y = job * b->band_h;
+    bitmap_t band;
+    if (bitmap_view(&band, batch->dst, 0, y, batch->dst->w, b->band_h) < 0) {
+        return;
+    }
+    bitmap_reset_clip(&band);
+    band.damage = NULL;
+    for (int i = b->starts[job]; i < b->starts[job + 1]; i++) {
+        const batch_sprite_t* sprite = &batch->sprites[batch->bins[i]];
+        _BLITS[sprite->op][sprite->hflip](&band, &sprite->src, sprite->x,
+                                          sprite->y - y);
+    }
+}
+
+
+void batch_draw(batch_t* batch) {
+    if (batch->count == 0) {
+        return;
+    }
+    bitmap_t* dst = batch->dst;
+    rect_t clip;
+    int nthreads = batch->pool ? batch->pool->nthreads : 1;
+    int band_h = max(BAND_MIN_H, (dst->h + nthreads * BANDS_PER_THREAD - 1)
+                                 / (nthreads * BANDS_PER_THREAD));
+    int nbands = (dst->h + band_h - 1) / band_h;
+    int* starts = calloc(nbands + 1, sizeof(int));
+    rect_t* damage = calloc(nbands, sizeof(rect_t));
+    if (!starts || !damage) {
+        goto sequential;
+    }
+
+    // Sprites are binned in every band they cross, in submission order.
+    for (int i = 0; i < batch->count; i++) {
+        const batch_sprite_t* sprite = &batch->sprites[i];
+        int b1 = (sprite->y + sprite->src.h - 1) / band_h;
+        for (int b = sprite->y / band_h; b <= b1; b++) {
+            starts[b + 1]++;
+            damage[b] = rect_union(damage[b], (rect_t){
+                sprite->x, sprite->y, sprite->src.w, sprite->src.h,
+            });
+        }
+    }
+    for (int b = 0; b < nbands; b++) {
+        starts[b + 1] += starts[b];
+    }
+    if (starts[nbands] > batch->bins_capacity) {
+        free(batch->bins);
+        batch->bins = malloc(starts[nbands] * sizeof(int));
+        batch->bins_capacity = batch->bins ? starts[nbands] : 0;
+        if (!batch->bins) {
+            goto sequential;
+        }
+    }
+    int* next = malloc(nbands * sizeof(int));
+    if (!next) {
+        goto sequential;
+    }
+    memcpy(next, starts, nbands * sizeof(int));
+    for (int i = 0; i < batch->count; i++) {
+        const batch_sprite_t* sprite = &batch->sprites[i];
+        int b1 = (sprite->y + sprite->src.h - 1) / band_h;
+        for (int b = sprite->y / band_h; b <= b1; b++) {
+            batch->bins[next[b]++] = i;
+        }
+    }
+    free(next);
+
+    // Tables built on first use are built before drawing in parallel.
+    simd_kernels();
+    pixconv_plan_get(PIXFMT_FB, PIXFMT_FB);
+    _band_job_t job = {
+        .batch = batch,
+        .starts = starts,
+        .band_h = band_h,
+    };
+    if (batch->pool) {
+        pool_run(batch->pool, _draw_band, &job, nbands);
+    } else {
+        for (int b = 0; b < nbands; b++) {
+            _draw_band(&job, b);
+        }
+    }
+    for (int b = 0; b < nbands; b++) {
+        rect_t r = rect_intersect(damage[b],
+                                  (rect_t){0, b * band_h, dst->w, band_h});
+        bitmap_add_damage(dst, r.x, r.y, r.w, r.h);
+    }
+    goto done;
+
+  sequential:
+    // Like bands, ignoring the current clip rectangle.
+    clip = dst->clip;
+    bitmap_reset_clip(dst);
+    for (int i = 0; i < batch->count; i++) {
+        const batch_sprite_t* sprite = &batch->sprites[i];
+        _BLITS[sprite->op][sprite->hflip](dst, &sprite->src, sprite->x,
+                                          sprite->y);
+    }
+    bitmap_set_clip(dst, clip.x, clip.y, clip.w, clip.h);
+
+  done:
+    free(starts);
+    free(damage);
+    batch->count = 0;
+}
+
+
+#ifdef TEST
+#include <assert.h>
+
+
+static void _fill_random(bitmap_t* bmp) {
+    uint8_t* mem = (uint8_t*)bmp->mem;
+    for (size_t i = 0; i < bitmap_memsize(bmp); i++) {
+        mem[i] = rand();
+    }
+}
+
+
+// Queue random sprites of `sprites` and `sheet` on `batch`, blitting
+// them on `ref` at the same time.
+static void _add_sprites(batch_t* batch, bitmap_t* ref,
+                         const bitmap_t* sprites, int nsprites,
+                         const bitmap_t* sheet)
+{
+    for (int i = 0; i < 200; i++) {
+        int x = rand() % (ref->w + 40) - 20;
+        int y = rand() % (ref->h + 40) - 20;
+        batch_op_t op = rand() % BATCH_OP_MAX;
+        bool hflip = rand() % 2;
+        if (i % 4 == 3) {
+            int sx = rand() % (sheet->w - 8), sy = rand() % (sheet->h - 8);
+            int sw = 1 + rand() % 8, sh = 1 + rand() % 8;
+            bitmap_t region;
+            bitmap_view(&region, (bitmap_t*)sheet, sx, sy, sw, sh);
+            assert(batch_add_region(batch, sheet, sx, sy, sw, sh, x, y, op,
+                                    hflip) == 0);
+            _BLITS[op][hflip](ref, &region, x, y);
+        } else {
+            const bitmap_t* src = &sprites[i % nsprites];
+            assert(batch_add(batch, src, x, y, op, hflip) == 0);
+            _BLITS[op][hflip](ref, src, x, y);
+        }
+    }
+}
+
+
+int main(void) {
+    pixfmt_t fb = pixfmt_get(PIXFMT_RGB24);
+    pixfmt_set_fb(&fb);
+    srand(7);
+
+    bitmap_t sprites[3], sheet, dst, ref;
+    bitmap_init(&sprites[0], 13, 9);
+    bitmap_init(&sprites[1], 5, 40);
+    bitmap_init(&sprites[2], 31, 17);
+    for (int i = 0; i < 3; i++) {
+        _fill_random(&sprites[i]);
+        for (int x = 0; x < sprites[i].w; x += 3) {
+            *bitmap_pixel_addr(&sprites[i], x, x % sprites[i].h) =
+                get_mask_color();
+        }
+    }
+    bitmap_init(&sheet, 48, 32);
+    _fill_random(&sheet);
+    bitmap_init(&dst, 120, 150);
+    bitmap_init(&ref, 120, 150);
+
+    pool_t pool;
+    assert(pool_init(&pool, 3, NULL) == 0);
+    pool_t* pools[] = {NULL, &pool};
+    for (int p = 0; p < 2; p++) {
+        // TEST batch_draw, draws like sequential blits
+        batch_t batch;
+        batch_init(&batch, &dst, pools[p]);
+        _fill_random(&dst);
+        memcpy(ref.mem, dst.mem, bitmap_memsize(&dst));
+        _add_sprites(&batch, &ref, sprites, 3, &sheet);
+        batch_draw(&batch);
+        assert(batch.count == 0);
+        assert(!memcmp(dst.mem, ref.mem, bitmap_memsize(&dst)));
+
+        // TEST batch_draw, keeps sprites in the clip rectangle they
+        // were queued with, and the current one
+        bitmap_set_clip(&dst, 10, 23, 70, 90);
+        bitmap_set_clip(&ref, 10, 23, 70, 90);
+        _add_sprites(&batch, &ref, sprites, 3, &sheet);
+        bitmap_set_clip(&dst, 50, 0, 20, 20);
+        batch_draw(&batch);
+        assert(!memcmp(dst.mem, ref.mem, bitmap_memsize(&dst)));
+        assert(dst.clip.x == 50 && dst.clip.y == 0);
+        assert(dst.clip.w == 20 && dst.clip.h == 20);
+        bitmap_reset_clip(&dst);
+        bitmap_reset_clip(&ref);
+
+        // TEST batch_draw, draws nothing once emptied
+        batch_draw(&batch);
+        assert(!memcmp(dst.mem, ref.mem, bitmap_memsize(&dst)));
+        batch_wipe(&batch);
+    }
+    pool_wipe(&pool);
+
+    bitmap_wipe(&ref);
+    bitmap_wipe(&dst);
+    bitmap_wipe(&sheet);
+    for (int i = 0; i < 3; i++) {
+        bitmap_wipe(&sprites[i]);
+    }
+    return 0;
+}
+
+
+#endif
@@ -6,21 +6,213 @@
     #error "undefined BLIT_FUNC_SUFFIX"
 #endif
 
+// Optional blit of `_n` contiguous 32 bits pixels, for operations
+// having a row kernel.
+//   BLIT_ROW_FUNC(_dst, _src, _n)
+
+// Optional blit of `_n` raw source pixels on contiguous 32 bits pixels,
+// for operations converting the source pixels themselves with `_plan`.
+//   BLIT_CONV_ROW_FUNC(_plan, _dst, _raw, _n)
+
+// Defined for operations without RLE blits.
+//   BLIT_NO_RLE
+
+// Conversion plan of a blit, NULL without conversion.
+#ifndef BLIT_PLAN
+    #define BLIT_PLAN(_dst, _src) _blit_plan(_dst, _src)
+#endif
+
+// Blit of a source pixel converted to the destination format, `_raw`
+// being the pixel before its conversion. Converted pixels only go
+// through BLIT_ROW_FUNC if the operation doesn't need their raw value.
+#ifndef BLIT_CONV_PIXEL_FUNC
+    #define BLIT_CONV_PIXEL_FUNC(_dst, _raw, _conv) \
+        BLIT_PIXEL_FUNC(_dst, _conv)
+    #define _BLIT_CONV_ROWS
+#endif
+
 
 #define __TCONCAT(x, y) x ## y
 #define _TCONCAT(x, y) __TCONCAT(x, y)
 #define FUNC(_name) _TCONCAT(_name, BLIT_FUNC_SUFFIX)
 
 
+// Packed storage -----------------------------------------------------
+// Blit `n` pixels of `spsize` bytes, `sstep` bytes apart, to `n`
+// contiguous pixels of `dpsize` bytes. Inlined with constant sizes, so
+// that each storage width pair gets its own loop.
+__attribute__((always_inline))
+static inline void FUNC(_blit_packed_n)(uint8_t* d, int dpsize,
+                                        const uint8_t* s, int spsize,
+                                        int sstep, int n)
+{
+    for (int i = 0; i < n; i++) {
+        pixel_t dp = pixel_load(d, dpsize);
+        BLIT_PIXEL_FUNC(dp, pixel_load(s, spsize));
+        pixel_store(d, dpsize, dp);
+        d += dpsize;
+        s += sstep;
+    }
+}
+
+
+static void FUNC(_blit_packed_row)(uint8_t* d, int dpsize,
+                                   const uint8_t* s, int spsize,
+                                   int sstep, int n)
+{
+#ifdef BLIT_MEMCPY
+    if (dpsize == spsize && sstep == spsize) {
+        memcpy(d, s, n * dpsize);
+        return;
+    }
+#endif
+#define CASE(_d, _s) \
+      case _d * 8 + _s: \
+        FUNC(_blit_packed_n)(d, _d, s, _s, sstep, n); \
+        break;
+    switch (dpsize * 8 + spsize) {
+      CASE(1, 1) CASE(1, 4) CASE(4, 1)
+      CASE(2, 2) CASE(2, 3) CASE(2, 4)
+      CASE(3, 2) CASE(3, 3) CASE(3, 4)
+      CASE(4, 2) CASE(4, 3) CASE(4, 4)
+      default:
+        break;
+    }
+#undef CASE
+}
+
+
+// Format conversion ------------------------------------------------
+// Blit `n` (at most BLIT_CHUNK) source pixels converted by `plan` to
+// contiguous pixels of `dpsize` bytes. The plan converts the whole
+// chunk at once, and copies convert directly into 32 bits destinations.
+static void FUNC(_blit_conv_chunk)(uint8_t* d, int dpsize,
+                                   const pixel_t* raw, int n,
+                                   const pixconv_plan_t* plan)
+{
+#ifdef BLIT_CONV_ROW_FUNC
+    if (dpsize == sizeof(pixel_t)) {
+        BLIT_CONV_ROW_FUNC(plan, (pixel_t*)d, raw, n);
+        return;
+    }
+    pixel_t row[BLIT_CHUNK];
+    for (int i = 0; i < n; i++) {
+        row[i] = pixel_load(d + i * dpsize, dpsize);
+    }
+    BLIT_CONV_ROW_FUNC(plan, row, raw, n);
+    for (int i = 0; i < n; i++) {
+        pixel_store(d + i * dpsize, dpsize, row[i]);
+    }
+    return;
+#endif
+#ifdef BLIT_MEMCPY
+    if (dpsize == sizeof(pixel_t)) {
+        plan->row(plan, (pixel_t*)d, raw, n);
+        return;
+    }
+#endif
+    pixel_t conv[BLIT_CHUNK];
+    plan->row(plan, conv, raw, n);
+    if (dpsize == sizeof(pixel_t)) {
+        pixel_t* dp = (pixel_t*)d;
+#if defined(BLIT_ROW_FUNC) && defined(_BLIT_CONV_ROWS)
+        BLIT_ROW_FUNC(dp, conv, n);
+        return;
+#endif
+        for (int i = 0; i < n; i++) {
+            BLIT_CONV_PIXEL_FUNC(dp[i], raw[i], conv[i]);
+        }
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        pixel_t dp = pixel_load(d, dpsize);
+        BLIT_CONV_PIXEL_FUNC(dp, raw[i], conv[i]);
+        pixel_store(d, dpsize, dp);
+        d += dpsize;
+    }
+}
+
+
+// Like `_blit_packed_row()`, converting the source pixels with `plan`,
+// after their expansion through `palette` if not NULL.
+static void FUNC(_blit_conv_row)(uint8_t* d, int dpsize,
+                                 const uint8_t* s, int spsize,
+                                 int sstep, int n,
+                                 const pixconv_plan_t* plan,
+                                 const pixel_t* palette)
+{
+#ifdef BLIT_MEMCPY
+    // Palette colors are already in the destination format.
+    if (palette && dpsize == sizeof(pixel_t)
+     && plan->in_fmt == plan->out_fmt)
+    {
+        _blit_expand((pixel_t*)d, s, spsize, sstep, n, palette);
+        return;
+    }
+#endif
+    pixel_t raw[BLIT_CHUNK];
+    while (n > 0) {
+        int k = min(n, BLIT_CHUNK);
+        const pixel_t* chunk = (const pixel_t*)s;
+        if (palette) {
+            _blit_expand(raw, s, spsize, sstep, k, palette);
+            chunk = raw;
+        } else
+        if (spsize != (int)sizeof(pixel_t)
+         || sstep != (int)sizeof(pixel_t))
+        {
+            for (int i = 0; i < k; i++) {
+                raw[i] = pixel_load(s + i * sstep, spsize);
+            }
+            chunk = raw;
+        }
+        FUNC(_blit_conv_chunk)(d, dpsize, chunk, k, plan);
+        d += k * dpsize;
+        s += k * sstep;
+        n -= k;
+    }
+}
+
+
+// Blit `n` pixels of `src` from `s`, `sstep` bytes apart, to contiguous
+// pixels of `dst` from `d`.
+static void FUNC(_blit_span)(uint8_t* d, const bitmap_t* dst,
+                             const uint8_t* s, const bitmap_t* src,
+                             int sstep, int n, const pixconv_plan_t* plan)
+{
+    if (plan) {
+        FUNC(_blit_conv_row)(d, dst->psize, s, src->psize, sstep, n, plan,
+                             src->palette);
+        return;
+    }
+    if (dst->psize != (int)sizeof(pixel_t)
+     || sstep != (int)sizeof(pixel_t))
+    {
+        FUNC(_blit_packed_row)(d, dst->psize, s, src->psize, sstep, n);
+        return;
+    }
+    pixel_t* dest_addr = (pixel_t*)d;
+    const pixel_t* src_addr = (const pixel_t*)s;
+#ifdef BLIT_ROW_FUNC
+    BLIT_ROW_FUNC(dest_addr, src_addr, n);
+    return;
+#endif
+    for (int i = 0; i < n; i++) {
+        BLIT_PIXEL_FUNC(dest_addr[i], src_addr[i]);
+    }
+}
+
+
 // In the following blit functions,
 // x, y are the coordinates requested by the user,
 // dx, dy are the current final coordinates on the `dst` bitmap and
 // sx, sy are the current final coordinates on the `src` bitmap.
 //
-// user-coordinates are clamped to avoid copy in invalid memory. For exemple,
-// if the `x` given by the user is negative, we ajust the source coordinate
-// `sx` such that it corresponds to the shift given by the user (the distance
-// from x to zero), as shown below, with x = -3, dx = 0, sx = 3 :
+// user-coordinates are clamped to the clip rectangle of `dst` to avoid copy
+// in invalid memory. For exemple, if the `x` given by the user is left of
+// the rectangle (at zero here), we ajust the source coordinate `sx` such
+// that it corresponds to the shift given by the user (the distance from x
+// to the rectangle), as shown below, with x = -3, dx = 0, sx = 3 :
 //
 //   x  dx
 //   |  |
@@ -37,66 +229,76 @@
 //      sx
 //
 static void FUNC(_blit_row)(bitmap_t* dst, const bitmap_t* src,
-                            int x, int dy, int sy)
+                            int x, int dy, int sy,
+                            const pixconv_plan_t* plan)
 {
-    int dx = max(0, x);
-    int sx = max(0, -x);
-    int max_size = min(src->w - sx, dst->w - dx);
-    if (max_size < 0) {
+    int dx = max(dst->clip.x, x);
+    int sx = dx - x;
+    int max_size = min(src->w - sx, dst->clip.x + dst->clip.w - dx);
+    if (max_size <= 0) {
         return;
     }
-    pixel_t* dest_addr = dst->mem + dy * dst->w + dx;
-    const pixel_t* src_addr = src->mem + sy * src->w + sx;
-    for (size_t i = 0; i < max_size; i++) {
-        BLIT_PIXEL_FUNC(dest_addr[i], src_addr[i]);
-    }
+    FUNC(_blit_span)(bitmap_addr(dst, dx, dy), dst, bitmap_addr(src, sx, sy),
+                     src, src->psize, max_size, plan);
 }
 
 
-static void FUNC(_fast_blit)(bitmap_t* dst, const bitmap_t* src,
-                             int x, int y)
-{
-    // If `y` is offscreen, we start to copy `src` from the `-y` row to
-    // `dst` on the first row.
-    int dy = max(0, y);
-    int sy = max(0, -y);
-    for (; dy < dst->h && sy < src->h; dy++, sy++) {
-        FUNC(_blit_row)(dst, src, x, dy, sy);
+void FUNC(bitmap_blit)(bitmap_t* dst, const bitmap_t* src, int x, int y) {
+    _add_clipped_damage(dst, x, y, src->w, src->h);
+    const pixconv_plan_t* plan = BLIT_PLAN(dst, src);
+    // If `y` is above the clip rectangle, we start to copy `src` from
+    // the row reaching its first row.
+    int dy = max(dst->clip.y, y);
+    int sy = dy - y;
+    for (; dy < dst->clip.y + dst->clip.h && sy < src->h; dy++, sy++) {
+        FUNC(_blit_row)(dst, src, x, dy, sy, plan);
     }
 }
 
 
-static void FUNC(_slow_blit)(bitmap_t* dst, const bitmap_t* src,
-                             int x, int y)
+// Blit `n` (at most BLIT_CHUNK) gathered source pixels to contiguous
+// pixels of `dpsize` bytes, converted by `plan` if not NULL.
+static void FUNC(_blit_gathered)(uint8_t* d, int dpsize, const pixel_t* raw,
+                                 int n, const pixconv_plan_t* plan)
 {
-    int dy = max(0, y);
-    int sy = max(0, -dy);
-    for (; dy < dst->h && sy < src->h; dy++, sy++) {
-        _blit_row(dst, src, x, dy, sy);
-        _convert_row(dst, x, dy, src->fmt);
+    if (plan) {
+        FUNC(_blit_conv_chunk)(d, dpsize, raw, n, plan);
+        return;
     }
-}
-
-
-void FUNC(bitmap_blit)(bitmap_t* dst, const bitmap_t* src, int x, int y) {
-    if (dst->fmt == src->fmt) {
-        FUNC(_fast_blit)(dst, src, x, y);
-    } else {
-        FUNC(_slow_blit)(dst, src, x, y);
+#ifdef BLIT_ROW_FUNC
+    if (dpsize == sizeof(pixel_t)) {
+        BLIT_ROW_FUNC((pixel_t*)d, raw, n);
+        return;
     }
+#endif
+    FUNC(_blit_packed_row)(d, dpsize, (const uint8_t*)raw, sizeof(pixel_t),
+                           sizeof(pixel_t), n);
 }
 
 
+// Blit source row `sy` on the span of destination row `dy`, gathering
+// its pixels by chunks.
 static void FUNC(_blit_scaled_row)(bitmap_t* dst, const bitmap_t* src,
-                                   int x, int y, int w, int sy)
+                                   const _scale_map_t* map, int dy, int sy,
+                                   const pixconv_plan_t* plan)
 {
-    int dx = max(0, x);
-    float sx = max(0, -x);
-    float xratio = src->w / (float)w;
-    for (; dx < min(x + w, dst->w) && sx * xratio < src->w; dx++, sx++)
+    uint8_t* d = bitmap_addr(dst, map->dx, dy);
+    const uint8_t* s = bitmap_addr(src, 0, sy);
+#ifdef BLIT_MEMCPY
+    if (!plan && dst->psize == sizeof(pixel_t)
+     && src->psize == sizeof(pixel_t))
     {
-        size_t src_off = sy * src->w + sx * xratio;
-        BLIT_PIXEL_FUNC(dst->mem[y * dst->w + dx], src->mem[src_off]);
+        simd_kernels()->scale((pixel_t*)d, (const pixel_t*)s, map->cols,
+                              map->w);
+        return;
+    }
+#endif
+    const pixel_t* palette = plan ? src->palette : NULL;
+    pixel_t raw[BLIT_CHUNK];
+    for (int i = 0; i < map->w; i += BLIT_CHUNK) {
+        int n = min(map->w - i, BLIT_CHUNK);
+        _scale_gather(raw, src, s, map->cols + i, n, palette);
+        FUNC(_blit_gathered)(d + i * dst->psize, dst->psize, raw, n, plan);
     }
 }
 
@@ -104,35 +306,8 @@ static void FUNC(_blit_scaled_row)(bitmap_t* dst, const bitmap_t* src,
 void FUNC(bitmap_scaled_blit)(bitmap_t* dst, const bitmap_t* src,
                               int x, int y, int w, int h)
 {
-    int dy = max(0, y);
-    float sy = max(0, -y);
-    float yratio = src->h / (float)h;
-    for (; dy < min(y + h, dst->h) && sy * yratio < src->h; dy++, sy++)
-    {
-        FUNC(_blit_scaled_row)(dst, src, x, dy, w, sy * yratio);
-    }
-}
-
-
-static void FUNC(_blit_scaled_region_row)(bitmap_t* dst, const bitmap_t* src,
-                                          int dst_x, int dst_y, int dst_w,
-                                          int src_x, int src_y,
-                                          int src_w)
-{
-    int dx = max(0, dst_x);
-    int sx = max(0, -dst_x);
-
-    int dx_max = min(dst_x + dst_w, dst->w);
-    int sx_max = min(src_x + src_w, src->w);
-
-    float xratio = src_w / (float)dst_w;
-
-
-    for (; dx < dx_max && src_x + sx * xratio < sx_max; dx++, sx++) {
-        size_t dst_off = dst_y * dst->w + dx;
-        size_t src_off = (size_t)(src_y * src->w + src_x + sx * xratio);
-        BLIT_PIXEL_FUNC(dst->mem[dst_off], src->mem[src_off]);
-    }
+    FUNC(bitmap_scaled_region_blit)(dst, src, 0, 0, src->w, src->h,
+                                    x, y, w, h);
 }
 
 
@@ -142,72 +317,175 @@ void FUNC(bitmap_scaled_region_blit)(bitmap_t* dst, const bitmap_t* src,
                                      int dst_x, int dst_y, int dst_w,
                                      int dst_h)
 {
-    int dy = max(0, dst_y);
-    float sy = max(0, -dst_y);
-
-    int dy_max = min(dst_y + dst_h, dst->h);
-    float sy_max = min(src_y + src_h, src->h);
-
-    float yratio = src_h / (float)dst_h;
-
-    for (; dy < dy_max && src_y + sy * yratio < sy_max; dy++, sy++) {
-        FUNC(_blit_scaled_region_row)(
-            dst, src,
-            dst_x, dy, dst_w,
-            src_x, src_y + sy * yratio, src_w
-        );
+    _scale_map_t map;
+    if (_scale_map_init(&map, dst, src, src_x, src_y, src_w, src_h,
+                        dst_x, dst_y, dst_w, dst_h, false) < 0)
+    {
+        return;
     }
+    bitmap_add_damage(dst, map.dx, map.dy, map.w, map.h);
+    const pixconv_plan_t* plan = BLIT_PLAN(dst, src);
+#ifdef BLIT_MEMCPY
+    int prev_sy = -1;
+#endif
+    uint32_t fy = map.fy;
+    for (int j = 0; j < map.h; j++, fy += map.ystep) {
+        int sy = map.sy + (fy >> 16);
+        int dy = map.dy + j;
+#ifdef BLIT_MEMCPY
+        // Rows sampling the same source row are identical.
+        if (sy == prev_sy) {
+            memcpy(bitmap_addr(dst, map.dx, dy),
+                   bitmap_addr(dst, map.dx, dy - 1), map.w * dst->psize);
+            continue;
+        }
+        prev_sy = sy;
+#endif
+        FUNC(_blit_scaled_row)(dst, src, &map, dy, sy, plan);
+    }
+    free(map.cols);
 }
 
 
 static void FUNC(_blit_row_hflip)(bitmap_t* dst, const bitmap_t* src,
-                                  int x, int dy, int sy)
+                                  int x, int dy, int sy,
+                                  const pixconv_plan_t* plan)
 {
-    int dx = max(0, x);
-    int sx = max(0, -x);
-    int max_size = min(src->w - sx, dst->w - dx);
-    if (max_size < 0) {
+    int dx = max(dst->clip.x, x);
+    int sx = dx - x;
+    int max_size = min(src->w - sx, dst->clip.x + dst->clip.w - dx);
+    if (max_size <= 0) {
         return;
     }
-    pixel_t* dest_addr = dst->mem + dy * dst->w + dx;
-    const pixel_t* src_addr = src->mem + sy * src->w + src->w - sx - 1;
-    for (size_t i = 0; i < max_size; i++) {
-        BLIT_PIXEL_FUNC(dest_addr[i], src_addr[-i]);
+    FUNC(_blit_span)(bitmap_addr(dst, dx, dy), dst,
+                     bitmap_addr(src, src->w - sx - 1, sy), src,
+                     -src->psize, max_size, plan);
+}
+
+
+void FUNC(bitmap_blit_hflip)(bitmap_t* dst, const bitmap_t* src, int x, int y)
+{
+    _add_clipped_damage(dst, x, y, src->w, src->h);
+    const pixconv_plan_t* plan = BLIT_PLAN(dst, src);
+    // If `y` is above the clip rectangle, we start to copy `src` from
+    // the row reaching its first row.
+    int dy = max(dst->clip.y, y);
+    int sy = dy - y;
+    for (; dy < dst->clip.y + dst->clip.h && sy < src->h; dy++, sy++) {
+        FUNC(_blit_row_hflip)(dst, src, x, dy, sy, plan);
     }
 }
 
 
-static void FUNC(_fast_blit_hflip)(bitmap_t* dst, const bitmap_t* src,
-                                   int x, int y)
+// Blit `n` pixels of destination row `dy` from `x`, sampling the source
+// from its 16.16 position (sx, sy) by chunks.
+static void FUNC(_blit_affine_row)(bitmap_t* dst, const bitmap_t* src,
+                                   const _affine_map_t* map, int x, int dy,
+                                   int n, int64_t sx, int64_t sy,
+                                   const pixconv_plan_t* plan)
 {
-    // If `y` is offscreen, we start to copy `src` from the `-y` row to
-    // `dst` on the first row.
-    int dy = max(0, y);
-    int sy = max(0, -y);
-    for (; dy < dst->h && sy < src->h; dy++, sy++) {
-        FUNC(_blit_row_hflip)(dst, src, x, dy, sy);
+    const pixel_t* palette = plan ? src->palette : NULL;
+    uint8_t* d = bitmap_addr(dst, x, dy);
+    int stride = src->stride;
+    int32_t xx = map->xx, xy = map->xy;
+    int offs[BLIT_CHUNK];
+    pixel_t raw[BLIT_CHUNK];
+    for (int i = 0; i < n; i += BLIT_CHUNK) {
+        int k = min(n - i, BLIT_CHUNK);
+        for (int j = 0; j < k; j++) {
+            offs[j] = (int)(sy >> 16) * stride + (int)(sx >> 16);
+            sx += xx;
+            sy += xy;
+        }
+#ifdef BLIT_MEMCPY
+        if (!plan && dst->psize == sizeof(pixel_t)
+         && src->psize == sizeof(pixel_t))
+        {
+            simd_kernels()->scale((pixel_t*)d + i, src->mem, offs, k);
+            continue;
+        }
+#endif
+        _scale_gather(raw, src, (const uint8_t*)src->mem, offs, k, palette);
+        FUNC(_blit_gathered)(d + i * dst->psize, dst->psize, raw, k, plan);
     }
 }
 
 
-static void FUNC(_slow_blit_hflip)(bitmap_t* dst, const bitmap_t* src,
-                                   int x, int y)
+// Source placed at (x, y), each pixel enlarged to `kx` x `ky` pixels:
+// source columns are computed once, and rows are gathered like scaled
+// blits'.
+static void FUNC(_blit_zoomed)(bitmap_t* dst, const bitmap_t* src,
+                               const _affine_map_t* map, int kx, int ky,
+                               int x, int y, const pixconv_plan_t* plan)
 {
-    int dy = max(0, y);
-    int sy = max(0, -dy);
-    for (; dy < dst->h && sy < src->h; dy++, sy++) {
-        _blit_row_hflip(dst, src, x, dy, sy);
-        _convert_row(dst, x, dy, src->fmt);
+    _scale_map_t cols = {
+        .dx = map->x0,
+        .w = map->x1 - map->x0,
+        .cols = malloc((map->x1 - map->x0) * sizeof(int)),
+    };
+    if (!cols.cols) {
+        return;
     }
+    for (int i = 0; i < cols.w; i++) {
+        cols.cols[i] = (cols.dx + i - x) / kx;
+    }
+#ifdef BLIT_MEMCPY
+    int prev_sy = -1;
+#endif
+    for (int dy = map->y0; dy < map->y1; dy++) {
+        int sy = (dy - y) / ky;
+#ifdef BLIT_MEMCPY
+        if (sy == prev_sy) {
+            memcpy(bitmap_addr(dst, cols.dx, dy),
+                   bitmap_addr(dst, cols.dx, dy - 1), cols.w * dst->psize);
+            continue;
+        }
+        prev_sy = sy;
+#endif
+        FUNC(_blit_scaled_row)(dst, src, &cols, dy, sy, plan);
+    }
+    free(cols.cols);
 }
 
 
-void FUNC(bitmap_blit_hflip)(bitmap_t* dst, const bitmap_t* src, int x, int y)
+void FUNC(bitmap_transform_blit)(bitmap_t* dst, const bitmap_t* src,
+                                 const affine_t* t)
 {
-    if (dst->fmt == src->fmt) {
-        FUNC(_fast_blit_hflip)(dst, src, x, y);
-    } else {
-        FUNC(_slow_blit_hflip)(dst, src, x, y);
+    _affine_map_t map;
+    if (_affine_map_init(&map, dst, src, t) < 0) {
+        return;
+    }
+    bitmap_add_damage(dst, map.x0, map.y0, map.x1 - map.x0, map.y1 - map.y0);
+    const pixconv_plan_t* plan = BLIT_PLAN(dst, src);
+
+    // Translations and flips copy rows, integer scales repeat pixels.
+    int kx, ky, x, y;
+    if (_affine_grid(t, &kx, &ky, &x, &y)) {
+        if (abs(kx) == 1 && abs(ky) == 1) {
+            for (int dy = map.y0; dy < map.y1; dy++) {
+                int sy = ky > 0 ? dy - y : y - 1 - dy;
+                if (kx > 0) {
+                    FUNC(_blit_row)(dst, src, x, dy, sy, plan);
+                } else {
+                    FUNC(_blit_row_hflip)(dst, src, x - src->w, dy, sy,
+                                          plan);
+                }
+            }
+            return;
+        }
+        if (kx > 0 && ky > 0) {
+            FUNC(_blit_zoomed)(dst, src, &map, kx, ky, x, y, plan);
+            return;
+        }
+    }
+
+    for (int dy = map.y0; dy < map.y1; dy++) {
+        int x0, x1;
+        int64_t sx, sy;
+        if (_affine_span(&map, dy, &x0, &x1, &sx, &sy)) {
+            FUNC(_blit_affine_row)(dst, src, &map, x0, dy, x1 - x0, sx, sy,
+                                   plan);
+        }
     }
 }
 
@@ -215,33 +493,65 @@ void FUNC(bitmap_blit_hflip)(bitmap_t* dst, const bitmap_t* src, int x, int y)
 void FUNC(bitmap_rotated_blit)(bitmap_t* dst, const bitmap_t* src,
                                int cx, int cy, float a)
 {
-    for (int y = 0; y < src->h; y++) {
-        for (int x = 0; x < src->w; x++) {
-            int rx, ry;
-            _rotate(x, y, src->w / 2, src->h / 2, a, &rx, &ry);
-            int dx = cx - src->w / 2 + rx;
-            int dy = cy - src->h / 2 + ry;
-            if (dx < 0 || dx >= dst->w || dy < 0 || dy >= dst->h) {
-                continue;
-            }
-            const pixel_t* src_addr = src->mem + y * src->w + x;
+    affine_t t = _rotation(src, cx, cy, a);
+    FUNC(bitmap_transform_blit)(dst, src, &t);
+}
 
-            pixel_t* dest_addr = dst->mem + dy * dst->w + dx;
-            BLIT_PIXEL_FUNC(*dest_addr, *src_addr);
 
-            // A pixel can be "between" two real pixels, so we fill the next
-            // one on the line to avoid black holes. Magic!
-            if (dx + 1 < dst->w && x + 1 < src->w) {
-                dest_addr = dst->mem + dy * dst->w + dx + 1;
-                BLIT_PIXEL_FUNC(*dest_addr, *src_addr);
+#ifndef BLIT_NO_RLE
+// Runs are blitted whole, clipped to the clip rectangle of `dst`, and
+// walked backwards from the other side of the sprite when flipped.
+static void FUNC(_blit_rle)(bitmap_t* dst, const bitmap_rle_t* rle,
+                            int x, int y, bool hflip)
+{
+    _add_clipped_damage(dst, x, y, rle->w, rle->h);
+    const bitmap_t* src = &rle->pixels;
+    const pixconv_plan_t* plan = BLIT_PLAN(dst, src);
+    int psize = src->psize;
+    rect_t c = dst->clip;
+    int r1 = min(rle->h, c.y + c.h - y);
+    for (int r = max(0, c.y - y); r < r1; r++) {
+        for (int i = rle->rows[r]; i < rle->rows[r + 1]; i++) {
+            const bitmap_rle_span_t* span = &rle->spans[i];
+            int dx = hflip ? x + rle->w - span->x - span->n : x + span->x;
+            int k0 = max(0, c.x - dx);
+            int k1 = min(span->n, c.x + c.w - dx);
+            if (k0 >= k1) {
+                continue;
             }
+            int offset = span->offset + (hflip ? span->n - 1 - k0 : k0);
+            FUNC(_blit_span)(bitmap_addr(dst, dx + k0, y + r), dst,
+                             bitmap_addr(src, offset, 0), src,
+                             hflip ? -psize : psize, k1 - k0, plan);
         }
     }
 }
 
 
+void FUNC(bitmap_rle_blit)(bitmap_t* dst, const bitmap_rle_t* rle,
+                           int x, int y)
+{
+    FUNC(_blit_rle)(dst, rle, x, y, false);
+}
+
+
+void FUNC(bitmap_rle_blit_hflip)(bitmap_t* dst, const bitmap_rle_t* rle,
+                                 int x, int y)
+{
+    FUNC(_blit_rle)(dst, rle, x, y, true);
+}
+#endif
+
+
 #undef BLIT_FUNC_SUFFIX
 #undef BLIT_PIXEL_FUNC
+#undef BLIT_CONV_PIXEL_FUNC
+#undef BLIT_ROW_FUNC
+#undef BLIT_CONV_ROW_FUNC
+#undef BLIT_PLAN
+#undef BLIT_MEMCPY
+#undef BLIT_NO_RLE
+#undef _BLIT_CONV_ROWS
 #undef __TCONCAT
 #undef _TCONCAT
 #undef FUNC
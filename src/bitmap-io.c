@@ -13,32 +13,75 @@
 
 
 // Loading ------------------------------------------------------------
+// Premultiply the RGBA32 colors of a row by their opacity, and inverse
+// their alpha-component.
+static void _premultiply_row(pixel_t* row, int w) {
+    for (int x = 0; x < w; x++) {
+        uint32_t opacity = row[x] >> 24;
+        pixel_t p = (0xff - opacity) << 24;
+        for (int c = 0; c < 24; c += 8) {
+            uint32_t v = ((row[x] >> c) & 0xff) * opacity + 128;
+            p |= ((v + (v >> 8)) >> 8) << c;
+        }
+        row[x] = p;
+    }
+}
+
+
+static int _load_alpha(bitmap_t* bmp, pixel_t* data, int w, int h) {
+    if (bitmap_init_ex(bmp, PIXFMT_RGBA32, w, h) != 0) {
+        return 1;
+    }
+    for (int y = 0; y < h; y++) {
+        pixel_t* dst = bitmap_pixel_addr(bmp, 0, y);
+        memcpy(dst, data + y * w, w * sizeof(pixel_t));
+        _premultiply_row(dst, w);
+    }
+    return 0;
+}
+
+
 int bitmap_load(bitmap_t* bmp, const char* path) {
+    return bitmap_load_ex(bmp, path, 0);
+}
+
+
+int bitmap_load_ex(bitmap_t* bmp, const char* path, uint32_t options) {
     int w, h, n;
     pixel_t* data = (pixel_t*)stbi_load(path, &w, &h, &n, 4);
     if (!data) {
         fprintf(stderr, "Couldn't read image file '%s'\n", path);
         goto error;
     }
+    if (options & BITMAP_LOAD_ALPHA) {
+        if (_load_alpha(bmp, data, w, h) != 0) {
+            goto error;
+        }
+        stbi_image_free(data);
+        return 0;
+    }
     if (bitmap_init(bmp, w, h) != 0) {
         goto error;
     }
 
     bool alpha = has_alpha(bmp->fmt);
-    pixel_t* dst = bmp->mem;
-    pixel_t* src = data;
     for (size_t y = 0; y < h; y++) {
+        pixel_t* src = data + y * w;
+        pixel_t* dst = bitmap_pixel_addr(bmp, 0, y);
         for (size_t x = 0; x < w; x++) {
             // Inverse alpha-component (0 means full color, 1 no color)
-            *src = (*src & 0x00ffffff) | ((0xff - (*src >> 24)) << 24);
-            *dst = pixel_conv(PIXFMT_RGBA32, bmp->fmt, *src);
-            if (!alpha && (*src & 0xff00ff) == 0xff00ff) {
+            src[x] = (src[x] & 0x00ffffff) | ((0xff - (src[x] >> 24)) << 24);
+        }
+        pixel_convert_row(PIXFMT_RGBA32, bmp->fmt, dst, src, w);
+        if (alpha) {
+            continue;
+        }
+        for (size_t x = 0; x < w; x++) {
+            if ((src[x] & 0xff00ff) == 0xff00ff) {
                 // XXX this can lead to bugs if RGB24 is not encoded
                 //     as I think it should be :p
-                *dst = 0xff000000;
+                dst[x] = 0xff000000;
             }
-            dst++;
-            src++;
         }
     }
 
@@ -98,16 +141,38 @@ static enum imgfmt _find_fmt(const char* path) {
 
 
 static void* _prepare_data(const bitmap_t* bmp, pixfmt_id_t pixfmt) {
-    size_t psize = pixfmt_get(pixfmt).bpp / 8;
-    void* data = malloc(bmp->w * bmp->h * psize);
-    for (int i = 0; i < bmp->w * bmp->h; i++) {
-        pixel_t* pixel = (pixel_t*)(data + i * psize);
-        *pixel = 0xff000000
-               | pixel_conv(bmp->fmt, pixfmt, bmp->mem[i]);
-        if ((bmp->mem[i] & 0xff000000) == 0xff000000) {
-            *pixel = 0x00000000;
+    // Indexed bitmaps are saved with the colors of their palette.
+    pixfmt_id_t fmt = bmp->palette ? PIXFMT_FB : bmp->fmt;
+    int psize = pixfmt_get(pixfmt).bpp / 8;
+    uint8_t* data = malloc(bmp->w * bmp->h * psize);
+    pixel_t* src = malloc(bmp->w * sizeof(pixel_t));
+    pixel_t* row = malloc(bmp->w * sizeof(pixel_t));
+    if (!data || !src || !row) {
+        free(data);
+        data = NULL;
+        goto end;
+    }
+    for (int y = 0; y < bmp->h; y++) {
+        for (int x = 0; x < bmp->w; x++) {
+            src[x] = bitmap_pixel(bmp, x, y);
+            if (bmp->palette) {
+                src[x] = bmp->palette[src[x] & 0xff];
+            }
+        }
+        pixel_convert_row(fmt, pixfmt, row, src, bmp->w);
+        uint8_t* dst = data + y * bmp->w * psize;
+        for (int x = 0; x < bmp->w; x++) {
+            pixel_t p = 0xff000000 | row[x];
+            if ((src[x] & 0xff000000) == 0xff000000) {
+                p = 0x00000000;
+            }
+            pixel_store(dst + x * psize, psize, p);
         }
     }
+
+  end:
+    free(src);
+    free(row);
     return data;
 }
 
@@ -118,16 +183,19 @@ int bitmap_save(const bitmap_t* bmp, const char* path) {
     switch (_find_fmt(path)) {
       case IMGFMT_PNG:
         data = _prepare_data(bmp, PIXFMT_RGBA32);
+        CHECK(data);
         CHECK(stbi_write_png(path, bmp->w, bmp->h, 4, data, 0));
         break;
 
       case IMGFMT_BMP:
         data = _prepare_data(bmp, PIXFMT_RGB24);
+        CHECK(data);
         CHECK(stbi_write_bmp(path, bmp->w, bmp->h, 3, data));
         break;
 
       case IMGFMT_TGA:
         data = _prepare_data(bmp, PIXFMT_RGB24);
+        CHECK(data);
         CHECK(stbi_write_tga(path, bmp->w, bmp->h, 3, data));
         break;
 
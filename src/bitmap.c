@@ -1,10 +1,8 @@
 /*
  * JCFB bitmap implementations
  *
- * XXX Maybe we could use an additional member `stride` to `bitmap_t`,
- *     indicating the number of pixels between two rows.
- *     This could be used to do regions of bitmaps without memory copy,
- *     allowing for exemple to do clipping.
+ * Rows of a bitmap are `stride` pixels apart, which lets views share
+ * the memory of a region of their parent.
  */
 #include <math.h>
 #include <stdbool.h>
@@ -12,16 +10,22 @@
 
 
 #include "jcfb/bitmap.h"
+#include "jcfb/simd.h"
 #include "jcfb/util.h"
 
+#include "simd-internal.h"
+
 
 int bitmap_init(bitmap_t* bmp, int w, int h) {
     *bmp = (bitmap_t){
         .w = w,
         .h = h,
+        .stride = w,
+        .psize = sizeof(pixel_t),
         .fmt = PIXFMT_FB,
         .mem = calloc(w * h, sizeof(pixel_t)),
         .flags = BITMAP_FLAG_MEM_OWNER,
+        .clip = {0, 0, w, h},
     };
     if (!bmp->mem) {
         return -1;
@@ -35,76 +39,211 @@ int bitmap_init_from_memory(bitmap_t* bmp, int w, int h, void* mem)
     *bmp = (bitmap_t){
         .w = w,
         .h = h,
+        .stride = w,
+        .psize = sizeof(pixel_t),
         .fmt = PIXFMT_FB,
         .mem = mem,
         .flags = 0,
+        .clip = {0, 0, w, h},
     };
     return 0;
 }
 
 
+// Indexed bitmaps get a black palette.
+static int _init_palette(bitmap_t* bmp) {
+    if (bmp->fmt != PIXFMT_PAL8) {
+        return 0;
+    }
+    bmp->palette = calloc(256, sizeof(pixel_t));
+    if (!bmp->palette) {
+        free(bmp->mem);
+        bmp->mem = NULL;
+        return -1;
+    }
+    bmp->flags |= BITMAP_FLAG_PALETTE_OWNER;
+    return 0;
+}
+
+
 int bitmap_init_ex(bitmap_t* bmp, pixfmt_id_t fmt, int w, int h) {
     *bmp = (bitmap_t){
         .w = w,
         .h = h,
+        .stride = w,
+        .psize = sizeof(pixel_t),
         .fmt = fmt,
         .mem = calloc(w * h, sizeof(pixel_t)),
         .flags = BITMAP_FLAG_MEM_OWNER,
+        .clip = {0, 0, w, h},
     };
     if (!bmp->mem) {
         return -1;
     }
+    return _init_palette(bmp);
+}
+
+
+int bitmap_init_packed(bitmap_t* bmp, pixfmt_id_t fmt, int w, int h) {
+    size_t bpp = pixfmt_get(fmt).bpp;
+    int psize = (bpp == 8 || bpp == 16 || bpp == 24) ? bpp / 8
+              : sizeof(pixel_t);
+    *bmp = (bitmap_t){
+        .w = w,
+        .h = h,
+        .stride = w,
+        .psize = psize,
+        .fmt = fmt,
+        .mem = calloc(w * h, psize),
+        .flags = BITMAP_FLAG_MEM_OWNER,
+        .clip = {0, 0, w, h},
+    };
+    if (!bmp->mem) {
+        return -1;
+    }
+    return _init_palette(bmp);
+}
+
+
+int bitmap_view(bitmap_t* view, bitmap_t* parent, int x, int y, int w, int h)
+{
+    rect_t r = rect_intersect((rect_t){x, y, w, h},
+                              (rect_t){0, 0, parent->w, parent->h});
+    if (rect_is_empty(r)) {
+        return -1;
+    }
+    *view = (bitmap_t){
+        .w = r.w,
+        .h = r.h,
+        .stride = parent->stride,
+        .psize = parent->psize,
+        .fmt = parent->fmt,
+        .mem = bitmap_addr(parent, r.x, r.y),
+        .flags = 0,
+        .damage = parent->damage,
+        .damage_x = parent->damage_x + r.x,
+        .damage_y = parent->damage_y + r.y,
+        .palette = parent->palette,
+    };
+    bitmap_set_clip(view, parent->clip.x - r.x, parent->clip.y - r.y,
+                    parent->clip.w, parent->clip.h);
     return 0;
 }
 
 
+void bitmap_set_palette(bitmap_t* bmp, const pixel_t* colors, int first,
+                        int n)
+{
+    if (!bmp->palette || first < 0 || first >= 256) {
+        return;
+    }
+    n = min(n, 256 - first);
+    if (n <= 0) {
+        return;
+    }
+    memcpy(bmp->palette + first, colors, n * sizeof(pixel_t));
+    bitmap_add_damage(bmp, 0, 0, bmp->w, bmp->h);
+}
+
+
 void bitmap_wipe(bitmap_t* bmp) {
     if ((bmp->flags & BITMAP_FLAG_MEM_OWNER) && bmp->mem) {
         free(bmp->mem);
         bmp->mem = NULL;
     }
+    if ((bmp->flags & BITMAP_FLAG_PALETTE_OWNER) && bmp->palette) {
+        free(bmp->palette);
+    }
+    bmp->palette = NULL;
+    bitmap_track_damage(bmp, false);
 }
 
 
 pixel_t* bitmap_pixel_addr(bitmap_t* bmp, int x, int y) {
-    return &bmp->mem[y * bmp->w + x];
+    return &bmp->mem[y * bmp->stride + x];
 }
 
 
 pixel_t bitmap_pixel(const bitmap_t* bmp, int x, int y) {
-    return bmp->mem[y * bmp->w + x];
+    return pixel_load(bitmap_addr(bmp, x, y), bmp->psize);
 }
 
 
 size_t bitmap_memsize(const bitmap_t* bmp) {
-    return bmp->w * bmp->h * sizeof(pixel_t);
+    return bmp->stride * bmp->h * bmp->psize;
+}
+
+
+void bitmap_set_clip(bitmap_t* bmp, int x, int y, int w, int h) {
+    bmp->clip = rect_intersect((rect_t){x, y, w, h},
+                               (rect_t){0, 0, bmp->w, bmp->h});
+}
+
+
+void bitmap_reset_clip(bitmap_t* bmp) {
+    bmp->clip = (rect_t){0, 0, bmp->w, bmp->h};
+}
+
+
+int bitmap_push_clip(bitmap_t* bmp, int x, int y, int w, int h) {
+    if (bmp->clip_depth == BITMAP_CLIP_DEPTH) {
+        return -1;
+    }
+    bmp->clip_stack[bmp->clip_depth++] = bmp->clip;
+    bmp->clip = rect_intersect(bmp->clip, (rect_t){x, y, w, h});
+    return 0;
+}
+
+
+void bitmap_pop_clip(bitmap_t* bmp) {
+    if (bmp->clip_depth > 0) {
+        bmp->clip = bmp->clip_stack[--bmp->clip_depth];
+    }
 }
 
 
 void bitmap_put_pixel(bitmap_t* bmp, int x, int y, pixel_t color) {
-    if (x < 0 || x >= bmp->w || y < 0 || y >= bmp->h) {
+    if (!bitmap_is_clipped_in(bmp, x, y)) {
         return;
     }
-    bmp->mem[y * bmp->w + x] = color;
+    pixel_store(bitmap_addr(bmp, x, y), bmp->psize, color);
+    bitmap_add_damage(bmp, x, y, 1, 1);
 }
 
 
 void bitmap_put_pixel_blend_add(bitmap_t* bmp, int x, int y, pixel_t color) {
-    if (x < 0 || x >= bmp->w || y < 0 || y >= bmp->h) {
+    if (!bitmap_is_clipped_in(bmp, x, y)) {
         return;
     }
-    bmp->mem[y * bmp->w + x] = pixel_blend_add(
-        bmp->mem[y * bmp->w + x], color
-    );
+    void* addr = bitmap_addr(bmp, x, y);
+    pixel_store(addr, bmp->psize,
+                pixel_blend_add(pixel_load(addr, bmp->psize), color));
+    bitmap_add_damage(bmp, x, y, 1, 1);
 }
 
 
 void bitmap_clear(bitmap_t* bmp, pixel_t color) {
-    for (int y = 0; y < bmp->h; y++) {
-        for (int x = 0; x < bmp->w; x++) {
-            bmp->mem[y * bmp->w + x] = color;
+    rect_t c = bmp->clip;
+    if (rect_is_empty(c)) {
+        return;
+    }
+    if (bmp->psize != sizeof(pixel_t)) {
+        // Fill the first row, then copy it.
+        uint8_t* row = bitmap_addr(bmp, c.x, c.y);
+        for (int x = 0; x < c.w; x++) {
+            pixel_store(row + x * bmp->psize, bmp->psize, color);
+        }
+        for (int y = 1; y < c.h; y++) {
+            memcpy(bitmap_addr(bmp, c.x, c.y + y), row, c.w * bmp->psize);
         }
+        bitmap_add_damage(bmp, c.x, c.y, c.w, c.h);
+        return;
     }
+    const simd_kernels_t* kernels = simd_kernels();
+    for (int y = c.y; y < c.y + c.h; y++) {
+        kernels->clear(bitmap_pixel_addr(bmp, c.x, y), color, c.w);
+    }
+    bitmap_add_damage(bmp, c.x, c.y, c.w, c.h);
 }
 
 
@@ -113,33 +252,427 @@ bool bitmap_is_in(const bitmap_t* bmp, int x, int y) {
 }
 
 
-static void _convert_row(bitmap_t* dst, int x, int dy,
-                         pixfmt_id_t pixfmt)
+int bitmap_track_damage(bitmap_t* bmp, bool track) {
+    if (!track) {
+        if (bmp->flags & BITMAP_FLAG_DAMAGE_OWNER) {
+            free(bmp->damage);
+        }
+        bmp->damage = NULL;
+        bmp->flags &= ~BITMAP_FLAG_DAMAGE_OWNER;
+        return 0;
+    }
+    if (!bmp->damage) {
+        bmp->damage = calloc(1, sizeof(rect_list_t));
+        if (!bmp->damage) {
+            return -1;
+        }
+        bmp->flags |= BITMAP_FLAG_DAMAGE_OWNER;
+        bmp->damage_x = 0;
+        bmp->damage_y = 0;
+    }
+    return 0;
+}
+
+
+void bitmap_add_damage(bitmap_t* bmp, int x, int y, int w, int h) {
+    if (!bmp->damage) {
+        return;
+    }
+    rect_t r = rect_intersect((rect_t){x, y, w, h},
+                              (rect_t){0, 0, bmp->w, bmp->h});
+    if (rect_is_empty(r)) {
+        return;
+    }
+    r.x += bmp->damage_x;
+    r.y += bmp->damage_y;
+    rect_list_add(bmp->damage, r);
+}
+
+
+void bitmap_clear_damage(bitmap_t* bmp) {
+    if (bmp->damage) {
+        bmp->damage->count = 0;
+    }
+}
+
+
+// Damage the part of the (x, y, w, h) area inside the clip rectangle.
+static void _add_clipped_damage(bitmap_t* dst, int x, int y, int w, int h) {
+    rect_t r = rect_intersect((rect_t){x, y, w, h}, dst->clip);
+    bitmap_add_damage(dst, r.x, r.y, r.w, r.h);
+}
+
+
+// Blits between formats convert the source pixels on their way to the
+// destination, by chunks of BLIT_CHUNK pixels.
+#define BLIT_CHUNK 256
+
+
+// Format of the pixels read from `src`: PIXFMT_PAL8 indexes expand to
+// framebuffer colors.
+static pixfmt_id_t _blit_src_fmt(const bitmap_t* src) {
+    return src->palette ? PIXFMT_FB : src->fmt;
+}
+
+
+// Conversion plan of a blit, NULL without conversion.
+static const pixconv_plan_t* _blit_plan(const bitmap_t* dst,
+                                        const bitmap_t* src)
 {
-    int dx = max(0, x);
-    for (; dx < dst->w; dx++) {
-        pixel_t old_color = dst->mem[dy * dst->w + dx];
-        pixel_t new_color = pixel_conv(pixfmt, dst->fmt, old_color);
-        dst->mem[dy * dst->w + dx] = new_color;
+    if (dst->fmt == src->fmt) {
+        return NULL;
     }
+    return pixconv_plan_get(_blit_src_fmt(src), dst->fmt);
 }
 
 
-static void _rotate(int x, int y, int cx, int cy, float a, int* rx, int* ry) {
-    int dx = x - cx;
-    int dy = y - cy;
+// Pixel (x, y) of `src`, expanded through its palette.
+static inline pixel_t _blit_src_pixel(const bitmap_t* src, int x, int y) {
+    pixel_t p = pixel_load(bitmap_addr(src, x, y), src->psize);
+    return src->palette ? src->palette[p & 0xff] : p;
+}
+
 
-    *rx = cx + cos(a) * dx - sin(a) * dy;
-    *ry = cy + sin(a) * dx + cos(a) * dy;
+// Read `n` pixels of `spsize` bytes, `sstep` bytes apart, expanding
+// them through `palette`.
+__attribute__((always_inline))
+static inline void _blit_expand(pixel_t* raw, const uint8_t* s, int spsize,
+                                int sstep, int n, const pixel_t* palette)
+{
+    if (spsize == 1 && sstep == 1) {
+        for (int i = 0; i < n; i++) {
+            raw[i] = palette[s[i]];
+        }
+        return;
+    }
+    if (spsize == 1) {
+        for (int i = 0; i < n; i++) {
+            raw[i] = palette[s[i * sstep]];
+        }
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        raw[i] = palette[pixel_load(s + i * sstep, spsize) & 0xff];
+    }
+}
+
+
+// Scaled blits sample the source in 16.16 fixed point: the destination
+// span inside both bitmaps, and the source column of each of its
+// pixels, are computed once per blit.
+typedef struct {
+    int dx, dy;             /* First destination pixel */
+    int w, h;               /* Destination span */
+    int* cols;              /* Source column of each span column */
+    uint8_t* weights;       /* Filtered blits: weight of the next column */
+    void* lerp_map;         /* Filtered blits: kernels map of the body */
+    int body;               /* Filtered blits: columns having a next one */
+    int sy;                 /* Source row of the unscaled blit origin */
+    uint32_t fy, ystep;     /* 16.16 source row offset of the first row */
+    int top, bottom;        /* Source rows which may be sampled */
+} _scale_map_t;
+
+
+// Filtered blits sample the source at the center of destination pixels,
+// `f` being their 16.16 offset from `s`, between the pixel `*c` and the
+// next one `*n`, clamped to the [lo, hi) span.
+static inline void _filter_sample(int s, int32_t f, int lo, int hi,
+                                  int* c, int* n, uint8_t* w)
+{
+    *c = s + (f >> 16);
+    *w = f >> 8 & 0xff;
+    if (*c < lo) {
+        *c = lo;
+        *w = 0;
+    } else if (*c >= hi - 1) {
+        *c = hi - 1;
+        *w = 0;
+    }
+    *n = *w ? *c + 1 : *c;
+}
+
+
+// Offset of the center of the first destination pixel to the center of
+// the first source pixel, for 16.16 steps `step`.
+static inline int32_t _filter_bias(uint32_t step) {
+    return (int32_t)(step / 2) - 0x8000;
+}
+
+
+static int _scale_map_init(_scale_map_t* map, const bitmap_t* dst,
+                           const bitmap_t* src,
+                           int sx, int sy, int sw, int sh,
+                           int dx, int dy, int dw, int dh, bool filtered)
+{
+    if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0) {
+        return -1;
+    }
+    uint32_t xstep = ((uint32_t)sw << 16) / dw;
+    uint32_t ystep = ((uint32_t)sh << 16) / dh;
+    int sx_min = max(0, sx), sx_max = min(sx + sw, src->w);
+    int sy_min = max(0, sy), sy_max = min(sy + sh, src->h);
+
+    // Columns and rows are clipped to the destination, then to the
+    // source, the source coordinate growing with the destination one.
+    rect_t c = dst->clip;
+    int i0 = max(0, c.x - dx), i1 = min(dw, c.x + c.w - dx);
+    while (i0 < i1 && sx + (int)(i0 * xstep >> 16) < sx_min) {
+        i0++;
+    }
+    while (i1 > i0 && sx + (int)((i1 - 1) * xstep >> 16) >= sx_max) {
+        i1--;
+    }
+    int j0 = max(0, c.y - dy), j1 = min(dh, c.y + c.h - dy);
+    while (j0 < j1 && sy + (int)(j0 * ystep >> 16) < sy_min) {
+        j0++;
+    }
+    while (j1 > j0 && sy + (int)((j1 - 1) * ystep >> 16) >= sy_max) {
+        j1--;
+    }
+    if (i0 >= i1 || j0 >= j1) {
+        return -1;
+    }
+
+    int w = i1 - i0;
+    size_t size = w * sizeof(int);
+    if (filtered) {
+        size += SIMD_LERP_MAP_SIZE(w) + w;
+    }
+    *map = (_scale_map_t){
+        .dx = dx + i0,
+        .dy = dy + j0,
+        .w = w,
+        .h = j1 - j0,
+        .cols = malloc(size),
+        .sy = sy,
+        .fy = j0 * ystep,
+        .ystep = ystep,
+        .top = sy_min,
+        .bottom = sy_max,
+    };
+    if (!map->cols) {
+        return -1;
+    }
+    uint32_t fx = i0 * xstep;
+    if (!filtered) {
+        for (int i = 0; i < w; i++, fx += xstep) {
+            map->cols[i] = sx + (fx >> 16);
+        }
+        return 0;
+    }
+    map->lerp_map = map->cols + w;
+    map->weights = (uint8_t*)map->lerp_map + SIMD_LERP_MAP_SIZE(w);
+    for (int i = 0; i < w; i++, fx += xstep) {
+        int next;
+        _filter_sample(sx, (int32_t)fx + _filter_bias(xstep), sx_min, sx_max,
+                       &map->cols[i], &next, &map->weights[i]);
+        if (map->cols[i] < sx_max - 1) {
+            map->body = i + 1;
+        }
+    }
+    const simd_kernels_t* kernels = simd_kernels();
+    if (kernels->scale_lerp_map) {
+        kernels->scale_lerp_map(map->lerp_map, map->cols, map->weights,
+                                map->body);
+    }
+    return 0;
+}
+
+
+// Gather the pixels of source row `s` at `n` columns, expanded through
+// `palette` if not NULL.
+static void _scale_gather(pixel_t* raw, const bitmap_t* src,
+                          const uint8_t* s, const int* cols, int n,
+                          const pixel_t* palette)
+{
+    if (palette) {
+        for (int i = 0; i < n; i++) {
+            pixel_t p = pixel_load(s + cols[i] * src->psize, src->psize);
+            raw[i] = palette[p & 0xff];
+        }
+    } else if (src->psize == sizeof(pixel_t)) {
+        simd_kernels()->scale(raw, (const pixel_t*)s, cols, n);
+    } else {
+        for (int i = 0; i < n; i++) {
+            raw[i] = pixel_load(s + cols[i] * src->psize, src->psize);
+        }
+    }
+}
+
+
+// Transformed blits map each destination pixel back to the source, in
+// 16.16 fixed point, with the inverse of the transform: the source
+// position changes by (xx, xy) along destination rows, and by (yx, yy)
+// along columns.
+typedef struct {
+    int x0, y0, x1, y1;     /* Destination box, clipped */
+    int64_t sx, sy;         /* 16.16 source position of pixel (x0, y0) */
+    int32_t xx, xy, yx, yy; /* 16.16 source steps */
+    int w, h;               /* Source dimensions */
+} _affine_map_t;
+
+
+// Sets `*v` to `f` in 16.16 fixed point, if it fits.
+static inline bool _fixed(double f, int32_t* v) {
+    if (!(fabs(f) < 32767.0)) {
+        return false;
+    }
+    *v = lround(f * 65536);
+    return true;
+}
+
+
+// Returns -1 if the transformed source isn't on `dst`, or is flat, or
+// the transform isn't finite.
+static int _affine_map_init(_affine_map_t* map, const bitmap_t* dst,
+                            const bitmap_t* src, const affine_t* t)
+{
+    double det = (double)t->a * t->d - (double)t->b * t->c;
+    if (!(fabs(det) > 1e-9) || !isfinite(det)
+     || !isfinite(t->tx) || !isfinite(t->ty))
+    {
+        return -1;
+    }
+    double xmin = INFINITY, xmax = -INFINITY;
+    double ymin = INFINITY, ymax = -INFINITY;
+    for (int i = 0; i < 4; i++) {
+        double u = i & 1 ? src->w : 0;
+        double v = i & 2 ? src->h : 0;
+        double x = t->a * u + t->b * v + t->tx;
+        double y = t->c * u + t->d * v + t->ty;
+        xmin = fmin(xmin, x);
+        xmax = fmax(xmax, x);
+        ymin = fmin(ymin, y);
+        ymax = fmax(ymax, y);
+    }
+    // The box is clipped before its conversion: an empty one may be
+    // anywhere, a clipped one is within the clip rectangle.
+    rect_t c = dst->clip;
+    double x0 = fmax(c.x, floor(xmin)), x1 = fmin(c.x + c.w, ceil(xmax));
+    double y0 = fmax(c.y, floor(ymin)), y1 = fmin(c.y + c.h, ceil(ymax));
+    if (!(x0 < x1 && y0 < y1)) {
+        return -1;
+    }
+    *map = (_affine_map_t){
+        .x0 = x0, .y0 = y0, .x1 = x1, .y1 = y1,
+        .w = src->w,
+        .h = src->h,
+    };
+    if (!_fixed(t->d / det, &map->xx) || !_fixed(-t->c / det, &map->xy)
+     || !_fixed(-t->b / det, &map->yx) || !_fixed(t->a / det, &map->yy))
+    {
+        return -1;
+    }
+    // Destination pixels are sampled at their center, stepping from the
+    // corner of the unclipped box (or not too far from the clipped one),
+    // so that clipping doesn't move the samples. Positions too far to
+    // step along the box in 64 bits sample nothing.
+    int64_t ox = fmax(floor(xmin), x0 - (double)(1 << 24));
+    int64_t oy = fmax(floor(ymin), y0 - (double)(1 << 24));
+    double u = ox + 0.5 - t->tx, v = oy + 0.5 - t->ty;
+    double sx = (t->d * u - t->b * v) / det * 65536;
+    double sy = (t->a * v - t->c * u) / det * 65536;
+    if (!(fabs(sx) < 0x1p60 && fabs(sy) < 0x1p60)) {
+        return -1;
+    }
+    map->sx = llround(sx)
+            + map->xx * (map->x0 - ox) + map->yx * (map->y0 - oy);
+    map->sy = llround(sy)
+            + map->xy * (map->x0 - ox) + map->yy * (map->y0 - oy);
+    return 0;
+}
+
+
+// Fast paths of transforms only scaling by integers (negative ones
+// flip) and translating by whole pixels: sets the factors and the
+// translation.
+static bool _affine_grid(const affine_t* t, int* kx, int* ky, int* x,
+                         int* y)
+{
+    if (t->b != 0 || t->c != 0
+     || t->a != rintf(t->a) || t->d != rintf(t->d)
+     || t->tx != rintf(t->tx) || t->ty != rintf(t->ty)
+     || fabsf(t->a) > 65536 || fabsf(t->d) > 65536
+     || fabsf(t->tx) > 1 << 30 || fabsf(t->ty) > 1 << 30)
+    {
+        return false;
+    }
+    *kx = t->a;
+    *ky = t->d;
+    *x = t->tx;
+    *y = t->ty;
+    return true;
+}
+
+
+// Transform rotating `src` by `a` around its center, then moving the
+// center to (cx, cy).
+static affine_t _rotation(const bitmap_t* src, int cx, int cy, float a) {
+    affine_t t = affine_translate(affine_identity(), -(src->w / 2),
+                                  -(src->h / 2));
+    return affine_translate(affine_rotate(t, a), cx, cy);
+}
+
+
+static inline int64_t _floor_div(int64_t a, int64_t b) {
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+
+// Clip steps [*k0, *k1) to those for which `f + k * d` is in [0, lim).
+static void _clip_steps(int64_t f, int64_t d, int64_t lim, int* k0,
+                        int* k1)
+{
+    if (d == 0) {
+        if (f < 0 || f >= lim) {
+            *k1 = *k0;
+        }
+        return;
+    }
+    int64_t lo, hi;
+    if (d > 0) {
+        lo = -_floor_div(f, d);
+        hi = _floor_div(lim - 1 - f, d);
+    } else {
+        lo = -_floor_div(lim - 1 - f, -d);
+        hi = _floor_div(f, -d);
+    }
+    *k0 = clamp(lo, *k0, *k1);
+    *k1 = clamp(hi + 1, *k0, *k1);
+}
+
+
+// Span [*x0, *x1) of destination row `y` which samples the source, and
+// the 16.16 source position of its first pixel. Returns false if empty.
+static bool _affine_span(const _affine_map_t* map, int y, int* x0, int* x1,
+                         int64_t* sx, int64_t* sy)
+{
+    int dy = y - map->y0;
+    int64_t fx = map->sx + (int64_t)map->yx * dy;
+    int64_t fy = map->sy + (int64_t)map->yy * dy;
+    int k0 = 0, k1 = map->x1 - map->x0;
+    _clip_steps(fx, map->xx, (int64_t)map->w << 16, &k0, &k1);
+    _clip_steps(fy, map->xy, (int64_t)map->h << 16, &k0, &k1);
+    if (k0 >= k1) {
+        return false;
+    }
+    *x0 = map->x0 + k0;
+    *x1 = map->x0 + k1;
+    *sx = fx + (int64_t)map->xx * k0;
+    *sy = fy + (int64_t)map->xy * k0;
+    return true;
 }
 
 
 #define BLIT_PIXEL_FUNC(_dst, _src) _dst = _src
+#define BLIT_ROW_FUNC(_dst, _src, _n) simd_kernels()->copy(_dst, _src, _n)
 #define BLIT_FUNC_SUFFIX
+#define BLIT_MEMCPY
 #include "bitmap-blit.inc.c"
 
 
 #define BLIT_PIXEL_FUNC(_dst, _src) _dst = pixel_blend_add(_dst, _src)
+#define BLIT_ROW_FUNC(_dst, _src, _n) pixel_blend_add_row(_dst, _src, _n)
 #define BLIT_FUNC_SUFFIX _blend_add
 #include "bitmap-blit.inc.c"
 
@@ -148,5 +681,766 @@ static void _rotate(int x, int y, int cx, int cy, float a, int* rx, int* ry) {
     if (_src != get_mask_color()) { \
         _dst = _src; \
     }
+// The mask color doesn't survive conversions.
+#define BLIT_CONV_PIXEL_FUNC(_dst, _raw, _conv) \
+    if (_raw != get_mask_color()) { \
+        _dst = _conv; \
+    }
+#define BLIT_ROW_FUNC(_dst, _src, _n) \
+    simd_kernels()->mask(_dst, _src, get_mask_color(), _n)
 #define BLIT_FUNC_SUFFIX _masked
+// RLE sprites already skip the masked pixels.
+#define BLIT_NO_RLE
 #include "bitmap-blit.inc.c"
+
+
+// Alpha blits composite every source pixel, through a plan even
+// between bitmaps of the same format.
+#define BLIT_PIXEL_FUNC(_dst, _src) _dst = _src
+#define BLIT_CONV_ROW_FUNC(_plan, _dst, _raw, _n) \
+    pixel_blend_over_row(_plan, _dst, _raw, _n)
+#define BLIT_PLAN(_dst, _src) \
+    pixconv_plan_get(_blit_src_fmt(_src), (_dst)->fmt)
+#define BLIT_FUNC_SUFFIX _alpha
+#include "bitmap-blit.inc.c"
+
+
+// RLE sprites --------------------------------------------------------
+// Pixels left out of RLE sprites: masked ones, and fully transparent
+// ones of sources having an alpha component (`alpha` being its mask).
+static inline bool _rle_skipped(const bitmap_t* src, int x, int y,
+                                pixel_t alpha)
+{
+    pixel_t p = _blit_src_pixel(src, x, y);
+    return p == get_mask_color() || (alpha && (p & alpha) == alpha);
+}
+
+
+int bitmap_rle_compile(bitmap_rle_t* rle, const bitmap_t* src) {
+    pixfmt_t f = pixfmt_get(_blit_src_fmt(src));
+    pixel_t alpha = ~(UINT32_MAX << f.sizes[COMP_ALPHA])
+                  << f.offs[COMP_ALPHA];
+
+    // Runs and pixels are counted first, to be stored contiguously.
+    int nspans = 0, npixels = 0;
+    for (int y = 0; y < src->h; y++) {
+        bool skipped = true;
+        for (int x = 0; x < src->w; x++) {
+            bool s = _rle_skipped(src, x, y, alpha);
+            nspans += skipped && !s;
+            npixels += !s;
+            skipped = s;
+        }
+    }
+    *rle = (bitmap_rle_t){
+        .w = src->w,
+        .h = src->h,
+        .spans = malloc(max(1, nspans) * sizeof(bitmap_rle_span_t)),
+        .rows = malloc((src->h + 1) * sizeof(int)),
+    };
+    int err = src->psize == sizeof(pixel_t)
+            ? bitmap_init_ex(&rle->pixels, src->fmt, max(1, npixels), 1)
+            : bitmap_init_packed(&rle->pixels, src->fmt, max(1, npixels), 1);
+    if (err < 0 || !rle->spans || !rle->rows) {
+        bitmap_rle_wipe(rle);
+        return -1;
+    }
+    if (src->palette) {
+        bitmap_set_palette(&rle->pixels, src->palette, 0, 256);
+    }
+
+    uint8_t* d = (uint8_t*)rle->pixels.mem;
+    int n = 0;
+    for (int y = 0; y < src->h; y++) {
+        rle->rows[y] = n;
+        for (int x = 0; x < src->w; x++) {
+            if (_rle_skipped(src, x, y, alpha)) {
+                continue;
+            }
+            int x0 = x;
+            while (x < src->w && !_rle_skipped(src, x, y, alpha)) {
+                x++;
+            }
+            int k = x - x0;
+            rle->spans[n++] = (bitmap_rle_span_t){
+                .x = x0,
+                .n = k,
+                .offset = (d - (uint8_t*)rle->pixels.mem) / src->psize,
+            };
+            memcpy(d, bitmap_addr(src, x0, y), k * src->psize);
+            d += k * src->psize;
+        }
+    }
+    rle->rows[src->h] = n;
+    return 0;
+}
+
+
+void bitmap_rle_wipe(bitmap_rle_t* rle) {
+    bitmap_wipe(&rle->pixels);
+    free(rle->spans);
+    free(rle->rows);
+    rle->spans = NULL;
+    rle->rows = NULL;
+}
+
+
+// Filtered blits -----------------------------------------------------
+// Sources are filtered in their format when its components are bytes,
+// in ARGB32 otherwise.
+static pixfmt_id_t _filter_fmt(pixfmt_id_t fmt) {
+    pixfmt_t f = pixfmt_get(fmt);
+    for (int c = 0; c < COMP_MAX; c++) {
+        if (f.sizes[c] && (f.sizes[c] != 8 || f.offs[c] % 8)) {
+            return PIXFMT_ARGB32;
+        }
+    }
+    return fmt;
+}
+
+
+typedef struct {
+    const bitmap_t* src;
+    const pixconv_plan_t* in;   /* Source to filtered pixels, or NULL */
+    const pixconv_plan_t* out;  /* Filtered to destination pixels */
+    int left, right;            /* Source columns read */
+    pixel_t* lines[2];          /* Source rows, if they need a conversion */
+    pixel_t* rows[2];           /* Source rows filtered horizontally */
+    int rows_y[2];
+} _filter_t;
+
+
+// Source row `y` of filtered pixels, at their column. Rows needing a
+// conversion are converted in `line`.
+static const pixel_t* _filter_line(const _filter_t* f, int y,
+                                   pixel_t* line)
+{
+    const bitmap_t* src = f->src;
+    const uint8_t* s = bitmap_addr(src, f->left, y);
+    pixel_t* d = line + f->left;
+    int n = f->right - f->left;
+    if (src->palette) {
+        _blit_expand(d, s, src->psize, src->psize, n, src->palette);
+    } else if (src->psize != sizeof(pixel_t)) {
+        for (int i = 0; i < n; i++) {
+            d[i] = pixel_load(s + i * src->psize, src->psize);
+        }
+    } else if (!f->in) {
+        return bitmap_addr(src, 0, y);
+    } else {
+        f->in->row(f->in, d, (const pixel_t*)s, n);
+        return line;
+    }
+    if (f->in) {
+        f->in->row(f->in, d, d, n);
+    }
+    return line;
+}
+
+
+// Source row `y` interpolated at the columns of `map`, those past its
+// body only sampling the last source column. The last two rows are
+// cached, and row `keep` isn't replaced.
+static const pixel_t* _filter_row(_filter_t* f, const _scale_map_t* map,
+                                  int y, int keep)
+{
+    for (int k = 0; k < 2; k++) {
+        if (f->rows_y[k] == y) {
+            return f->rows[k];
+        }
+    }
+    int k = f->rows_y[0] == keep;
+    const pixel_t* line = _filter_line(f, y, f->lines[0]);
+    const simd_kernels_t* kernels = simd_kernels();
+    kernels->scale_lerp(f->rows[k], line, map->cols, map->weights,
+                        map->lerp_map, map->body);
+    kernels->scale(f->rows[k] + map->body, line, map->cols + map->body,
+                   map->w - map->body);
+    f->rows_y[k] = y;
+    return f->rows[k];
+}
+
+
+// Rows are interpolated horizontally once, then each destination row
+// interpolates the two source rows around it.
+static void _filter_bilinear(_filter_t* f, bitmap_t* dst,
+                             const _scale_map_t* map)
+{
+    const simd_kernels_t* kernels = simd_kernels();
+    bool direct = !f->out && dst->psize == sizeof(pixel_t);
+    int32_t bias = _filter_bias(map->ystep);
+    uint32_t fy = map->fy;
+    for (int j = 0; j < map->h; j++, fy += map->ystep) {
+        int y, next;
+        uint8_t w;
+        _filter_sample(map->sy, (int32_t)fy + bias, map->top, map->bottom,
+                       &y, &next, &w);
+        const pixel_t* a = _filter_row(f, map, y, next);
+        const pixel_t* b = _filter_row(f, map, next, y);
+        uint8_t* d = bitmap_addr(dst, map->dx, map->dy + j);
+        pixel_t out[BLIT_CHUNK];
+        for (int i = 0; i < map->w; i += BLIT_CHUNK) {
+            int n = min(map->w - i, BLIT_CHUNK);
+            uint8_t* dp = d + i * dst->psize;
+            if (direct) {
+                kernels->lerp((pixel_t*)dp, a + i, b + i, w, n);
+            } else if (!w) {
+                _blit_gathered(dp, dst->psize, a + i, n, f->out);
+            } else {
+                kernels->lerp(out, a + i, b + i, w, n);
+                _blit_gathered(dp, dst->psize, out, n, f->out);
+            }
+        }
+    }
+}
+
+
+// Halving averages the 2x2 blocks of the source, which are the pixels
+// bilinear filtering would interpolate.
+static void _filter_box(_filter_t* f, bitmap_t* dst,
+                        const _scale_map_t* map)
+{
+    const simd_kernels_t* kernels = simd_kernels();
+    bool direct = !f->out && dst->psize == sizeof(pixel_t);
+    int x = map->cols[0];
+    int y = map->sy + (map->fy >> 16);
+    for (int j = 0; j < map->h; j++, y += 2) {
+        const pixel_t* a = _filter_line(f, y, f->lines[0]) + x;
+        const pixel_t* b = _filter_line(f, y + 1, f->lines[1]) + x;
+        uint8_t* d = bitmap_addr(dst, map->dx, map->dy + j);
+        pixel_t out[BLIT_CHUNK];
+        for (int i = 0; i < map->w; i += BLIT_CHUNK) {
+            int n = min(map->w - i, BLIT_CHUNK);
+            uint8_t* dp = d + i * dst->psize;
+            if (direct) {
+                kernels->box((pixel_t*)dp, a + 2 * i, b + 2 * i, n);
+            } else {
+                kernels->box(out, a + 2 * i, b + 2 * i, n);
+                _blit_gathered(dp, dst->psize, out, n, f->out);
+            }
+        }
+    }
+}
+
+
+void bitmap_scaled_blit_filtered(bitmap_t* dst, const bitmap_t* src,
+                                 int x, int y, int w, int h)
+{
+    bitmap_scaled_region_blit_filtered(dst, src, 0, 0, src->w, src->h,
+                                       x, y, w, h);
+}
+
+
+void bitmap_scaled_region_blit_filtered(bitmap_t* dst, const bitmap_t* src,
+                                        int src_x, int src_y, int src_w,
+                                        int src_h,
+                                        int dst_x, int dst_y, int dst_w,
+                                        int dst_h)
+{
+    // Indexes can't be interpolated.
+    if (dst->fmt == PIXFMT_PAL8) {
+        bitmap_scaled_region_blit(dst, src, src_x, src_y, src_w, src_h,
+                                  dst_x, dst_y, dst_w, dst_h);
+        return;
+    }
+    _scale_map_t map;
+    if (_scale_map_init(&map, dst, src, src_x, src_y, src_w, src_h,
+                        dst_x, dst_y, dst_w, dst_h, true) < 0)
+    {
+        return;
+    }
+    bitmap_add_damage(dst, map.dx, map.dy, map.w, map.h);
+    pixfmt_id_t src_fmt = _blit_src_fmt(src);
+    pixfmt_id_t fmt = _filter_fmt(src_fmt);
+    _filter_t f = {
+        .src = src,
+        .in = fmt == src_fmt ? NULL : pixconv_plan_get(src_fmt, fmt),
+        .out = fmt == dst->fmt ? NULL : pixconv_plan_get(fmt, dst->fmt),
+        .left = max(0, src_x),
+        .right = min(src_x + src_w, src->w),
+        .rows_y = {-1, -1},
+    };
+    int lines = src->palette || src->psize != sizeof(pixel_t) || f.in
+              ? 2 * src->w : 0;
+    pixel_t* mem = malloc((2 * map.w + lines) * sizeof(pixel_t));
+    if (!mem) {
+        free(map.cols);
+        return;
+    }
+    f.rows[0] = mem;
+    f.rows[1] = mem + map.w;
+    f.lines[0] = mem + 2 * map.w;
+    f.lines[1] = f.lines[0] + src->w;
+
+    bool inside = src_x >= 0 && src_y >= 0
+               && src_x + src_w <= src->w && src_y + src_h <= src->h;
+    if (inside && src_w == 2 * dst_w && src_h == 2 * dst_h) {
+        _filter_box(&f, dst, &map);
+    } else {
+        _filter_bilinear(&f, dst, &map);
+    }
+    free(mem);
+    free(map.cols);
+}
+
+
+// Transformed sources are sampled in any direction: they're filtered
+// from a copy in the filtered format, unless they are in it.
+void bitmap_transform_blit_filtered(bitmap_t* dst, const bitmap_t* src,
+                                    const affine_t* t)
+{
+    // Indexes can't be interpolated.
+    if (dst->fmt == PIXFMT_PAL8) {
+        bitmap_transform_blit(dst, src, t);
+        return;
+    }
+    _affine_map_t map;
+    if (_affine_map_init(&map, dst, src, t) < 0) {
+        return;
+    }
+    bitmap_add_damage(dst, map.x0, map.y0, map.x1 - map.x0, map.y1 - map.y0);
+    pixfmt_id_t src_fmt = _blit_src_fmt(src);
+    pixfmt_id_t fmt = _filter_fmt(src_fmt);
+    _filter_t f = {
+        .src = src,
+        .in = fmt == src_fmt ? NULL : pixconv_plan_get(src_fmt, fmt),
+        .out = fmt == dst->fmt ? NULL : pixconv_plan_get(fmt, dst->fmt),
+        .left = 0,
+        .right = src->w,
+    };
+    const pixel_t* pixels = src->mem;
+    int stride = src->stride;
+    pixel_t* copy = NULL;
+    if (src->palette || src->psize != sizeof(pixel_t) || f.in) {
+        copy = malloc((size_t)src->w * src->h * sizeof(pixel_t));
+        if (!copy) {
+            return;
+        }
+        for (int y = 0; y < src->h; y++) {
+            _filter_line(&f, y, copy + y * src->w);
+        }
+        pixels = copy;
+        stride = src->w;
+    }
+
+    for (int y = map.y0; y < map.y1; y++) {
+        int x0, x1;
+        int64_t sx, sy;
+        if (!_affine_span(&map, y, &x0, &x1, &sx, &sy)) {
+            continue;
+        }
+        uint8_t* d = bitmap_addr(dst, x0, y);
+        pixel_t out[BLIT_CHUNK];
+        for (int i = 0; i < x1 - x0; i += BLIT_CHUNK) {
+            int n = min(x1 - x0 - i, BLIT_CHUNK);
+            for (int j = 0; j < n; j++, sx += map.xx, sy += map.xy) {
+                int c, cn, r, rn;
+                uint8_t wx, wy;
+                _filter_sample(0, sx - 0x8000, 0, src->w, &c, &cn, &wx);
+                _filter_sample(0, sy - 0x8000, 0, src->h, &r, &rn, &wy);
+                const pixel_t* top = pixels + r * stride;
+                const pixel_t* bottom = pixels + rn * stride;
+                pixel_t above = simd_lerp(top[c], top[cn], wx);
+                pixel_t below = simd_lerp(bottom[c], bottom[cn], wx);
+                out[j] = simd_lerp(above, below, wy);
+            }
+            _blit_gathered(d + i * dst->psize, dst->psize, out, n, f.out);
+        }
+    }
+    free(copy);
+}
+
+
+void bitmap_rotated_blit_filtered(bitmap_t* dst, const bitmap_t* src,
+                                  int cx, int cy, float a)
+{
+    affine_t t = _rotation(src, cx, cy, a);
+    bitmap_transform_blit_filtered(dst, src, &t);
+}
+
+
+#ifdef TEST
+#include <assert.h>
+#include <stdlib.h>
+
+
+#include "jcfb/primitive.h"
+
+
+static void _fill_random(bitmap_t* bmp) {
+    pixel_t mask = bmp->psize == 4 ? 0xffffffff : (1u << 8 * bmp->psize) - 1;
+    for (int y = 0; y < bmp->h; y++) {
+        for (int x = 0; x < bmp->w; x++) {
+            pixel_store(bitmap_addr(bmp, x, y), bmp->psize, rand() & mask);
+        }
+    }
+}
+
+
+// Copy of `bmp`, owning its memory.
+static void _copy(bitmap_t* out, const bitmap_t* bmp) {
+    if (bmp->psize == 4) {
+        bitmap_init_ex(out, bmp->fmt, bmp->w, bmp->h);
+    } else {
+        bitmap_init_packed(out, bmp->fmt, bmp->w, bmp->h);
+    }
+    for (int y = 0; y < bmp->h; y++) {
+        for (int x = 0; x < bmp->w; x++) {
+            pixel_store(bitmap_addr(out, x, y), out->psize,
+                        bitmap_pixel(bmp, x, y));
+        }
+    }
+}
+
+
+// Checks that `dst` holds `src` at (x, y), inside its clip rectangle,
+// and the pixels of `before` everywhere else.
+static void _assert_blit(const bitmap_t* dst, const bitmap_t* before,
+                         const bitmap_t* src, int x, int y)
+{
+    for (int dy = 0; dy < dst->h; dy++) {
+        for (int dx = 0; dx < dst->w; dx++) {
+            bool in = dx >= x && dx < x + src->w && dy >= y && dy < y + src->h
+                   && bitmap_is_clipped_in(dst, dx, dy);
+            pixel_t p = in ? bitmap_pixel(src, dx - x, dy - y)
+                           : bitmap_pixel(before, dx, dy);
+            assert(bitmap_pixel(dst, dx, dy) == p);
+        }
+    }
+}
+
+
+static void _assert_equal(const bitmap_t* a, const bitmap_t* b) {
+    assert(a->w == b->w && a->h == b->h);
+    for (int y = 0; y < a->h; y++) {
+        for (int x = 0; x < a->w; x++) {
+            assert(bitmap_pixel(a, x, y) == bitmap_pixel(b, x, y));
+        }
+    }
+}
+
+
+#define CLIP_TEST_OPS   22
+
+
+// Draws the `op`th operation of the clipping tests on `bmp`.
+static void _draw_op(bitmap_t* bmp, int op, const bitmap_t* src,
+                     const bitmap_rle_t* rle)
+{
+    pixel_t a = 0x00c0ffee, b = 0x00123456, mask = get_mask_color();
+    affine_t t = affine_rotate(affine_identity(), 0.6);
+    t = affine_translate(affine_scale(t, 1.5, 2), 14, -3);
+    switch (op) {
+      case 0: bitmap_blit(bmp, src, 7, 5); break;
+      case 1: bitmap_blit_hflip(bmp, src, 30, 19); break;
+      case 2: bitmap_blit_masked(bmp, src, -4, 12); break;
+      case 3: bitmap_blit_blend_add(bmp, src, 20, 8); break;
+      case 4: bitmap_blit_alpha(bmp, src, 2, 2); break;
+      case 5: bitmap_scaled_blit(bmp, src, 3, 1, 37, 29); break;
+      case 6: bitmap_scaled_blit_filtered(bmp, src, 9, 4, 30, 21); break;
+      case 7: bitmap_transform_blit(bmp, src, &t); break;
+      case 8: bitmap_transform_blit_filtered(bmp, src, &t); break;
+      case 9: bitmap_rle_blit(bmp, rle, 11, 13); break;
+      case 10: bitmap_rle_blit_hflip(bmp, rle, 25, 0); break;
+      case 11: bitmap_clear(bmp, a); break;
+      case 12: draw_hline(bmp, a, -5, 60, 17); break;
+      case 13: draw_vline(bmp, a, 21, 40, -8); break;
+      case 14: fill_rect(bmp, a, 1, 3, 44, 38); break;
+      case 15: draw_rect(bmp, a, 6, 4, 35, 30); break;
+      case 16: fill_rect_blend_add(bmp, b, 8, 9, 25, 26); break;
+      case 17: fill_circle(bmp, a, 22, 16, 13); break;
+      case 18: draw_circle(bmp, b, 20, 20, 17); break;
+      case 19:
+        draw_dashed_hline(bmp, a, mask, -3, 50, 18, 2, 4, 1, 5);
+        break;
+      case 20:
+        draw_dashed_vline(bmp, a, b, 19, -2, 40, 1, 3, -1, 4);
+        break;
+      case 21:
+        draw_dashed_rect(bmp, a, b, 4, 3, 40, 29, 0, 5, 3);
+        break;
+    }
+}
+
+
+int main(void) {
+    pixfmt_t fb = pixfmt_get(PIXFMT_RGB24);
+    pixfmt_set_fb(&fb);
+    srand(5);
+
+    // TEST bitmap_view, shares the memory of its parent
+    for (int packed = 0; packed < 2; packed++) {
+        bitmap_t parent, before, view, inner, src, out;
+        if (packed) {
+            bitmap_init_packed(&parent, PIXFMT_RGB16, 40, 30);
+            bitmap_init_packed(&src, PIXFMT_RGB16, 8, 6);
+        } else {
+            bitmap_init(&parent, 40, 30);
+            bitmap_init(&src, 8, 6);
+        }
+        _fill_random(&parent);
+        _fill_random(&src);
+        assert(bitmap_view(&view, &parent, 5, 3, 20, 10) == 0);
+        assert(view.w == 20 && view.h == 10 && view.stride == 40);
+        for (int y = 0; y < view.h; y++) {
+            for (int x = 0; x < view.w; x++) {
+                assert(bitmap_pixel(&view, x, y)
+                       == bitmap_pixel(&parent, x + 5, y + 3));
+            }
+        }
+
+        // Views are clipped to their parent
+        assert(bitmap_view(&inner, &parent, 35, 25, 20, 20) == 0);
+        assert(inner.w == 5 && inner.h == 5);
+        assert(bitmap_view(&inner, &parent, 40, 0, 5, 5) == -1);
+        assert(bitmap_view(&inner, &parent, -5, 2, 5, 5) == -1);
+
+        // Blits into a view stay in its area of the parent
+        _copy(&before, &parent);
+        bitmap_blit(&view, &src, 15, 7);
+        bitmap_t area;
+        bitmap_view(&area, &before, 5, 3, 20, 10);
+        _assert_blit(&view, &area, &src, 15, 7);
+        bitmap_view(&area, &src, 0, 0, 5, 3);
+        _assert_blit(&parent, &before, &area, 20, 10);
+        bitmap_blit(&view, &src, -20, -6);
+        _assert_blit(&parent, &before, &area, 20, 10);
+        bitmap_wipe(&before);
+
+        // Views of views add up their offsets
+        _copy(&before, &parent);
+        assert(bitmap_view(&inner, &view, 2, 1, 6, 4) == 0);
+        assert(inner.stride == 40);
+        bitmap_blit(&inner, &src, 1, 1);
+        bitmap_view(&area, &src, 0, 0, 5, 3);
+        _assert_blit(&parent, &before, &area, 8, 5);
+        bitmap_wipe(&before);
+
+        // Blits from a view skip the rest of the parent's rows
+        _copy(&out, &view);
+        _fill_random(&out);
+        _copy(&before, &out);
+        bitmap_blit(&out, &inner, 3, 2);
+        _assert_blit(&out, &before, &inner, 3, 2);
+        bitmap_wipe(&before);
+        bitmap_wipe(&out);
+
+        bitmap_wipe(&src);
+        bitmap_wipe(&parent);
+    }
+
+    // TEST bitmap_transform_blit, matches the blits it generalizes
+    bitmap_t src, dst, ref, before;
+    bitmap_init(&src, 9, 7);
+    bitmap_init(&dst, 32, 24);
+    bitmap_init(&ref, 32, 24);
+    _fill_random(&src);
+    int pos[][2] = {{0, 0}, {3, 4}, {-4, -2}, {28, 20}};
+    for (int i = 0; i < 4; i++) {
+        int x = pos[i][0], y = pos[i][1];
+        _fill_random(&dst);
+        bitmap_wipe(&ref);
+        _copy(&ref, &dst);
+        affine_t t = affine_translate(affine_identity(), x, y);
+        bitmap_transform_blit(&dst, &src, &t);
+        bitmap_blit(&ref, &src, x, y);
+        _assert_equal(&dst, &ref);
+
+        t = affine_translate(affine_scale(affine_identity(), -1, 1),
+                             x + src.w, y);
+        bitmap_transform_blit(&dst, &src, &t);
+        bitmap_blit_hflip(&ref, &src, x, y);
+        _assert_equal(&dst, &ref);
+
+        t = affine_translate(affine_scale(affine_identity(), 2, 4), x, y);
+        bitmap_transform_blit(&dst, &src, &t);
+        bitmap_scaled_blit(&ref, &src, x, y, 2 * src.w, 4 * src.h);
+        _assert_equal(&dst, &ref);
+    }
+
+    // TEST bitmap_transform_blit, writes every pixel at most once
+    bitmap_t dot;
+    bitmap_init(&dot, 13, 11);
+    bitmap_clear(&dot, 0x00101010);
+    for (float a = 0.1; a < 6.3; a += 0.7) {
+        bitmap_clear(&dst, 0);
+        affine_t t = affine_translate(affine_identity(), -6.5, -5.5);
+        t = affine_translate(affine_rotate(affine_scale(t, 1.3, 0.9), a),
+                             16, 12);
+        bitmap_transform_blit_blend_add(&dst, &dot, &t);
+        int n = 0;
+        for (int y = 0; y < dst.h; y++) {
+            for (int x = 0; x < dst.w; x++) {
+                pixel_t p = bitmap_pixel(&dst, x, y);
+                assert(p == 0 || p == 0x00101010);
+                n += p != 0;
+            }
+        }
+        // The area of the transformed sprite, give or take its edges
+        assert(n > 13 * 11 * 1.17 - 40 && n < 13 * 11 * 1.17 + 40);
+    }
+    bitmap_wipe(&dot);
+
+    // TEST bitmap_transform_blit, draws nothing with flat, infinite or
+    // NaN transforms, or far from the destination
+    float inf = INFINITY;
+    affine_t odd[] = {
+        {0, 0, 4, 0, 0, 4}, {1, 2, 0, 2, 4, 0}, {1, 0, NAN, 0, 1, 0},
+        {inf, 0, 0, 0, 1, 0}, {1, 0, 0, 0, 1, -inf}, {1e-12, 0, 0, 0, 1, 0},
+        {1, 0, 1e12, 0, 1, 0}, {1, 0, -3e38, 0, 1, 3e38},
+    };
+    _fill_random(&dst);
+    _copy(&before, &dst);
+    for (int i = 0; i < sizeof(odd) / sizeof(*odd); i++) {
+        bitmap_transform_blit(&dst, &src, &odd[i]);
+        bitmap_transform_blit_filtered(&dst, &src, &odd[i]);
+        _assert_equal(&dst, &before);
+    }
+    affine_t huge = {1e30, 0, 0, 0, 1e30, 0};
+    bitmap_transform_blit(&dst, &src, &huge);
+    for (int y = 0; y < dst.h; y++) {
+        for (int x = 0; x < dst.w; x++) {
+            assert(bitmap_pixel(&dst, x, y) == bitmap_pixel(&src, 0, 0));
+        }
+    }
+    bitmap_wipe(&before);
+    bitmap_wipe(&ref);
+    bitmap_wipe(&dst);
+    bitmap_wipe(&src);
+
+    // TEST bitmap_rle_blit, matches masked blits
+    bitmap_t sprite;
+    bitmap_rle_t rle;
+    bitmap_init(&sprite, 23, 9);
+    bitmap_init(&dst, 32, 24);
+    bitmap_init(&ref, 32, 24);
+    _fill_random(&sprite);
+    for (int y = 0; y < sprite.h; y++) {
+        // Runs of every length, and a fully transparent row
+        for (int x = 0; x < sprite.w; x++) {
+            if (y == 4 || (x * y + x / 3) % 5 < 2 || x == y) {
+                *bitmap_pixel_addr(&sprite, x, y) = get_mask_color();
+            }
+        }
+    }
+    assert(bitmap_rle_compile(&rle, &sprite) == 0);
+    assert(rle.w == sprite.w && rle.h == sprite.h);
+    int rle_pos[][2] = {{0, 0}, {5, 7}, {-7, -3}, {20, 19}, {-30, 0}};
+    for (int i = 0; i < 5; i++) {
+        int x = rle_pos[i][0], y = rle_pos[i][1];
+        _fill_random(&dst);
+        bitmap_wipe(&ref);
+        _copy(&ref, &dst);
+        bitmap_rle_blit(&dst, &rle, x, y);
+        bitmap_blit_masked(&ref, &sprite, x, y);
+        _assert_equal(&dst, &ref);
+        bitmap_rle_blit_hflip(&dst, &rle, x, y);
+        bitmap_blit_hflip_masked(&ref, &sprite, x, y);
+        _assert_equal(&dst, &ref);
+        bitmap_rle_blit_blend_add(&dst, &rle, x, y);
+        for (int sy = max(0, -y); sy < min(sprite.h, ref.h - y); sy++) {
+            for (int sx = max(0, -x); sx < min(sprite.w, ref.w - x); sx++) {
+                pixel_t p = bitmap_pixel(&sprite, sx, sy);
+                pixel_t* q = bitmap_pixel_addr(&ref, x + sx, y + sy);
+                if (p != get_mask_color()) {
+                    *q = pixel_blend_add(p, *q);
+                }
+            }
+        }
+        _assert_equal(&dst, &ref);
+    }
+    bitmap_rle_wipe(&rle);
+
+    // TEST bitmap_rle_blit, copies sources without mask color whole
+    bitmap_wipe(&sprite);
+    bitmap_init_packed(&sprite, PIXFMT_RGB16, 11, 5);
+    _fill_random(&sprite);
+    assert(bitmap_rle_compile(&rle, &sprite) == 0);
+    bitmap_rle_blit(&dst, &rle, 3, 2);
+    bitmap_blit(&ref, &sprite, 3, 2);
+    _assert_equal(&dst, &ref);
+    bitmap_rle_wipe(&rle);
+    bitmap_wipe(&sprite);
+    bitmap_wipe(&ref);
+    bitmap_wipe(&dst);
+
+    // TEST bitmap_push_clip, bitmap_pop_clip, nest clip rectangles
+    bitmap_t bmp, view;
+    bitmap_init(&bmp, 46, 34);
+    rect_t c = bmp.clip;
+    assert(c.x == 0 && c.y == 0 && c.w == 46 && c.h == 34);
+    bitmap_set_clip(&bmp, -5, 30, 20, 20);
+    c = bmp.clip;
+    assert(c.x == 0 && c.y == 30 && c.w == 15 && c.h == 4);
+    bitmap_reset_clip(&bmp);
+    for (int i = 0; i < BITMAP_CLIP_DEPTH; i++) {
+        assert(bitmap_push_clip(&bmp, i, 2 * i, 40, 30) == 0);
+    }
+    assert(bitmap_push_clip(&bmp, 0, 0, 1, 1) == -1);
+    int n = BITMAP_CLIP_DEPTH - 1;
+    c = bmp.clip;
+    assert(c.x == n && c.y == 2 * n && c.w == 40 - n && c.h == 30 - 2 * n);
+    bitmap_pop_clip(&bmp);
+    c = bmp.clip;
+    assert(c.x == n - 1 && c.y == 2 * (n - 1));
+    for (int i = 0; i < BITMAP_CLIP_DEPTH + 2; i++) {
+        bitmap_pop_clip(&bmp);
+    }
+    c = bmp.clip;
+    assert(c.x == 0 && c.y == 0 && c.w == 46 && c.h == 34);
+
+    // TEST bitmap_view, inherits the clip rectangle inside its area
+    bitmap_set_clip(&bmp, 10, 5, 20, 10);
+    bitmap_view(&view, &bmp, 15, 8, 30, 20);
+    c = view.clip;
+    assert(c.x == 0 && c.y == 0 && c.w == 15 && c.h == 7);
+    bitmap_reset_clip(&bmp);
+
+    // TEST clipping, draws like unclipped operations, inside the clip
+    // rectangle only, and damages nothing outside of it
+    bitmap_t unclipped;
+    bitmap_init(&sprite, 17, 12);
+    _fill_random(&sprite);
+    for (int x = 0; x < sprite.w; x++) {
+        *bitmap_pixel_addr(&sprite, x, x % sprite.h) = get_mask_color();
+    }
+    assert(bitmap_rle_compile(&rle, &sprite) == 0);
+    rect_t clips[] = {
+        {0, 0, 46, 34}, {5, 7, 23, 19}, {20, 0, 1, 34}, {0, 17, 46, 1},
+        {40, 30, 10, 10}, {12, 12, 0, 5},
+    };
+    bitmap_track_damage(&bmp, true);
+    for (int i = 0; i < sizeof(clips) / sizeof(*clips); i++) {
+        for (int op = 0; op < CLIP_TEST_OPS; op++) {
+            _fill_random(&bmp);
+            _copy(&before, &bmp);
+            _copy(&unclipped, &bmp);
+            _draw_op(&unclipped, op, &sprite, &rle);
+            bitmap_clear_damage(&bmp);
+            c = clips[i];
+            bitmap_set_clip(&bmp, c.x, c.y, c.w, c.h);
+            _draw_op(&bmp, op, &sprite, &rle);
+            for (int r = 0; r < bmp.damage->count; r++) {
+                assert(rect_contains(bmp.clip, bmp.damage->rects[r]));
+            }
+            for (int y = 0; y < bmp.h; y++) {
+                for (int x = 0; x < bmp.w; x++) {
+                    bool in = bitmap_is_clipped_in(&bmp, x, y);
+                    pixel_t p = bitmap_pixel(in ? &unclipped : &before, x, y);
+                    assert(bitmap_pixel(&bmp, x, y) == p);
+                }
+            }
+            bitmap_reset_clip(&bmp);
+            bitmap_wipe(&before);
+            bitmap_wipe(&unclipped);
+        }
+    }
+    bitmap_rle_wipe(&rle);
+    bitmap_wipe(&sprite);
+    bitmap_wipe(&bmp);
+
+    return 0;
+}
+
+
+#endif
@@ -1,11 +1,15 @@
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <termios.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
@@ -18,22 +22,63 @@
 #include "jcfb/keyboard.h"
 #include "jcfb/pixel.h"
 #include "jcfb/bitmap.h"
+#include "jcfb/pool.h"
+#include "jcfb/scanout.h"
+#include "jcfb/simd.h"
+#include "jcfb/util.h"
 
 
 #define MAX_KEY_QUEUE   128
+#define MAX_PAGES       3
+#define DEFAULT_PERIOD  (1000000000 / 60)
+#define MAX_THREADS     64
 
 
 typedef struct fb {
     int fd;
     void* mem;
     pixfmt_t fmt;
-
-    int page, page_max;
+    scanout_t scanout;
+    pool_t pool;            /* Scanout threads */
+
+    int page, page_max;     /* Visible page & number of pages */
+    rect_list_t stale[MAX_PAGES];   /* Out of date areas of pages */
+    bool direct;            /* Frames are drawn in place */
+    int psize;              /* Bytes per pixel of the last frame */
+
+    // Tile diffing, `shadow` are copies of the pages' content
+    int tile_size;          /* 0 if disabled */
+    bool shadow_valid[MAX_PAGES];
+    pixel_t* shadow[MAX_PAGES];
     struct fb_var_screeninfo var_si;
     struct fb_fix_screeninfo fix_si;
 
     struct fb_var_screeninfo saved_var_si;
     struct fb_fix_screeninfo saved_fix_si;
+
+    // Frame pacing, times are CLOCK_MONOTONIC nanoseconds
+    bool has_vsync;         /* Driver supports FBIO_WAITFORVSYNC */
+    int64_t period;         /* Display refresh period */
+    int64_t vsync_origin;   /* Origin of the fallback vblank schedule */
+    int64_t deadline;       /* Next presentation deadline */
+    int64_t last_present;
+    jcfb_stats_t stats;
+    // Tile counts of the frame being drawn, published in `stats` once
+    // it's drawn.
+    unsigned long frame_tiles;
+    unsigned long frame_tiles_written;
+
+    // Asynchronous presentation, the presenter thread draws the frames
+    // handed over in `pending`.
+    bool async;
+    bool async_quit;
+    long async_interval;
+    pthread_t presenter;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bitmap_t buffers[2];
+    bitmap_t* pending;      /* Frame waiting for the presenter */
+    bitmap_t* presenting;   /* Frame being drawn by the presenter */
 } fb_t;
 
 
@@ -50,20 +95,358 @@ static size_t _FB_memsize() {
 }
 
 
-static void _draw_frame(bitmap_t* bmp) {
-    size_t bpp = _FB.var_si.bits_per_pixel / 8;
-    for (size_t y = 0; y < bmp->h; y++) {
-        uint8_t* dest = _FB.mem + y * _FB.fix_si.line_length;
-        pixel_t* src = bmp->mem + y * bmp->w;
-        for (size_t x = 0; x < bmp->w; x++) {
-            memcpy(dest + x * bpp, src + x, bpp);
+static int64_t _now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * (int64_t)1000000000 + ts.tv_nsec;
+}
+
+
+static void _sleep_until(int64_t t) {
+    struct timespec ts = {
+        .tv_sec = t / 1000000000,
+        .tv_nsec = t % 1000000000,
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)
+           == EINTR);
+}
+
+
+// Refresh period computed from the display timings, 60Hz if the driver
+// doesn't provide them.
+static int64_t _refresh_period(const struct fb_var_screeninfo* var_si) {
+    int64_t htotal = var_si->left_margin + var_si->xres
+                   + var_si->right_margin + var_si->hsync_len;
+    int64_t vtotal = var_si->upper_margin + var_si->yres
+                   + var_si->lower_margin + var_si->vsync_len;
+    // pixclock is in picoseconds
+    int64_t period = var_si->pixclock * htotal * vtotal / 1000;
+    if (period < 1000000 || period > 1000000000) {
+        return DEFAULT_PERIOD;
+    }
+    return period;
+}
+
+
+static void* _page_mem(int page) {
+    return (uint8_t*)_FB.mem
+         + page * _FB.var_si.yres * _FB.fix_si.line_length;
+}
+
+
+// Try to make `pages` screens fit in the virtual resolution, and
+// remap the framebuffer memory if the driver resized it.
+// On failure the framebuffer is left single-buffered.
+static int _set_virtual_pages(int pages) {
+    struct fb_var_screeninfo var_si = _FB.var_si;
+    struct fb_fix_screeninfo fix_si;
+    var_si.yres_virtual = var_si.yres * pages;
+    var_si.xoffset = 0;
+    var_si.yoffset = 0;
+    if (ioctl(_FB.fd, FBIOPUT_VSCREENINFO, &var_si) < 0
+    ||  ioctl(_FB.fd, FBIOGET_VSCREENINFO, &var_si) < 0
+    ||  ioctl(_FB.fd, FBIOGET_FSCREENINFO, &fix_si) < 0)
+    {
+        return -1;
+    }
+
+    if (fix_si.smem_len != _FB.fix_si.smem_len) {
+        munmap(_FB.mem, _FB_memsize());
+        _FB.mem = mmap(NULL, fix_si.smem_len,
+                       PROT_READ | PROT_WRITE, MAP_SHARED, _FB.fd, 0);
+        if (_FB.mem == MAP_FAILED) {
+            _FB.mem = NULL;
+            return -1;
+        }
+    }
+    memcpy(&_FB.fix_si, &fix_si, sizeof(struct fb_fix_screeninfo));
+    memcpy(&_FB.var_si, &var_si, sizeof(struct fb_var_screeninfo));
+
+    if (var_si.yres_virtual < var_si.yres * pages
+    ||  fix_si.smem_len < fix_si.line_length * var_si.yres * pages
+    ||  (pages > 1 && fix_si.ypanstep == 0))
+    {
+        return -1;
+    }
+    return scanout_init(&_FB.scanout, var_si.bits_per_pixel,
+                        fix_si.line_length, var_si.xres);
+}
+
+
+// Mark every page as entirely out of date.
+static void _invalidate_pages() {
+    rect_t screen = {0, 0, _FB.var_si.xres, _FB.var_si.yres};
+    for (int p = 0; p < MAX_PAGES; p++) {
+        _FB.stale[p].count = 0;
+        rect_list_add(&_FB.stale[p], screen);
+        _FB.shadow_valid[p] = false;
+    }
+}
+
+
+// Shadow address of pixel (x, y) of `page`. Shadows store pixels like
+// the frames, on `_FB.psize` bytes.
+static uint8_t* _shadow_addr(int page, int x, int y) {
+    return (uint8_t*)_FB.shadow[page]
+         + ((size_t)y * _FB.var_si.xres + x) * _FB.psize;
+}
+
+
+static void _shadow_copy(int page, const bitmap_t* bmp, rect_t r) {
+    for (int y = r.y; y < r.y + r.h; y++) {
+        memcpy(_shadow_addr(page, r.x, y), bitmap_addr(bmp, r.x, y),
+               r.w * bmp->psize);
+    }
+}
+
+
+static bool _tile_differs(int page, const bitmap_t* bmp, rect_t t) {
+    for (int y = t.y; y < t.y + t.h; y++) {
+        if (memcmp(_shadow_addr(page, t.x, y), bitmap_addr(bmp, t.x, y),
+                   t.w * bmp->psize)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Only copy the tiles of `r` which differ from the page's shadow.
+static void _diff_copy(bitmap_t* bmp, int page, rect_t r) {
+    int ts = _FB.tile_size;
+    for (int ty = r.y / ts * ts; ty < r.y + r.h; ty += ts) {
+        for (int tx = r.x / ts * ts; tx < r.x + r.w; tx += ts) {
+            rect_t t = rect_intersect((rect_t){tx, ty, ts, ts}, r);
+            // Bands may be diffed concurrently
+            __atomic_add_fetch(&_FB.frame_tiles, 1, __ATOMIC_RELAXED);
+            if (!_tile_differs(page, bmp, t)) {
+                continue;
+            }
+            scanout_copy(&_FB.scanout, _page_mem(page), bmp,
+                         t.x, t.y, t.w, t.h);
+            _shadow_copy(page, bmp, t);
+            __atomic_add_fetch(&_FB.frame_tiles_written, 1,
+                               __ATOMIC_RELAXED);
         }
     }
 }
 
 
+typedef struct {
+    bitmap_t* bmp;
+    int page;
+    rect_t r;
+    int band_y, band_h;     /* Bands are aligned on the tile grid */
+} _diff_job_t;
+
+
+static void _diff_band(void* arg, int job) {
+    const _diff_job_t* d = arg;
+    rect_t band = {d->r.x, d->band_y + job * d->band_h, d->r.w, d->band_h};
+    _diff_copy(d->bmp, d->page, rect_intersect(band, d->r));
+}
+
+
+// Split `r` in bands of whole tile rows diffed on the scanout threads.
+static void _diff_copy_pool(bitmap_t* bmp, int page, rect_t r) {
+    int ts = _FB.tile_size;
+    int y0 = r.y / ts * ts;
+    int rows = (r.y + r.h - y0 + ts - 1) / ts;
+    int nbands = min(_FB.pool.nthreads, rows);
+    if (nbands <= 1) {
+        _diff_copy(bmp, page, r);
+        return;
+    }
+    _diff_job_t d = {
+        .bmp = bmp,
+        .page = page,
+        .r = r,
+        .band_y = y0,
+        .band_h = (rows + nbands - 1) / nbands * ts,
+    };
+    pool_run(&_FB.pool, _diff_band, &d,
+             (r.y + r.h - y0 + d.band_h - 1) / d.band_h);
+}
+
+
+static bool _has_shadow(int page) {
+    if (!_FB.tile_size) {
+        return false;
+    }
+    if (!_FB.shadow[page]) {
+        _FB.shadow[page] = malloc(_FB.var_si.xres * _FB.var_si.yres
+                                  * sizeof(pixel_t));
+        _FB.shadow_valid[page] = false;
+    }
+    return _FB.shadow[page] != NULL;
+}
+
+
+static void _free_shadows() {
+    for (int p = 0; p < MAX_PAGES; p++) {
+        free(_FB.shadow[p]);
+        _FB.shadow[p] = NULL;
+        _FB.shadow_valid[p] = false;
+    }
+}
+
+
+// Copy the out of date areas of `page` from `bmp`.
+// Returns false if the page was already up to date.
+static bool _update_page(bitmap_t* bmp, int page) {
+    rect_list_t* stale = &_FB.stale[page];
+    if (!stale->count) {
+        return false;
+    }
+    rect_list_merge(stale);
+    rect_t bounds = {0, 0, bmp->w, bmp->h};
+    bool shadow = _has_shadow(page);
+    for (int i = 0; i < stale->count; i++) {
+        rect_t r = rect_intersect(stale->rects[i], bounds);
+        if (shadow && _FB.shadow_valid[page]) {
+            _diff_copy_pool(bmp, page, r);
+            continue;
+        }
+        scanout_copy_pool(&_FB.scanout, &_FB.pool, _page_mem(page), bmp,
+                          r.x, r.y, r.w, r.h);
+        if (shadow) {
+            _shadow_copy(page, bmp, r);
+        }
+    }
+    stale->count = 0;
+    // Pages are entirely out of date when their shadow is invalid, so
+    // the shadow is now complete, if the bitmap covers the screen.
+    bool covers = bmp->w >= (int)_FB.var_si.xres
+               && bmp->h >= (int)_FB.var_si.yres;
+    _FB.shadow_valid[page] = shadow && (_FB.shadow_valid[page] || covers);
+    return true;
+}
+
+
+// The damage of the frame makes every page out of date. Untracked
+// bitmaps are considered entirely damaged.
+static void _add_stale(bitmap_t* bmp) {
+    rect_t screen = {0, 0, _FB.var_si.xres, _FB.var_si.yres};
+    for (int p = 0; p < _FB.page_max; p++) {
+        if (!bmp->damage) {
+            rect_list_add(&_FB.stale[p], screen);
+            continue;
+        }
+        for (int i = 0; i < bmp->damage->count; i++) {
+            rect_list_add(&_FB.stale[p],
+                          rect_intersect(bmp->damage->rects[i], screen));
+        }
+    }
+    bitmap_clear_damage(bmp);
+}
+
+
+// Returns the page `bmp` aliases, or -1 if it has its own memory.
+static int _direct_page(const bitmap_t* bmp) {
+    for (int p = 0; p < _FB.page_max; p++) {
+        if (bmp->mem == _page_mem(p)) {
+            return p;
+        }
+    }
+    return -1;
+}
+
+
+// `bmp` was drawn in place in `page`: display it, then bring the next
+// hidden page up to date from it and move `bmp` there.
+static void _draw_direct(bitmap_t* bmp, int page) {
+    _FB.direct = true;
+    _add_stale(bmp);
+    _FB.stale[page].count = 0;
+    if (_FB.page_max == 1) {
+        return;
+    }
+
+    _FB.var_si.yoffset = page * _FB.var_si.yres;
+    if (ioctl(_FB.fd, FBIOPAN_DISPLAY, &_FB.var_si) < 0) {
+        fprintf(stderr, "Page flipping failed, using a single page\n");
+        memmove(_page_mem(0), _page_mem(page),
+                _FB.var_si.yres * _FB.fix_si.line_length);
+        jcfb_set_buffering(1);
+        _FB.stale[0].count = 0;
+        bmp->mem = _page_mem(0);
+        return;
+    }
+    _FB.page = page;
+
+    int next = (page + 1) % _FB.page_max;
+    rect_list_t* stale = &_FB.stale[next];
+    bitmap_t src;
+    bitmap_init_from_memory(&src, _FB.var_si.xres, _FB.var_si.yres,
+                            _page_mem(page));
+    src.stride = bmp->stride;
+    src.psize = bmp->psize;
+    rect_list_merge(stale);
+    for (int i = 0; i < stale->count; i++) {
+        rect_t r = stale->rects[i];
+        scanout_copy_pool(&_FB.scanout, &_FB.pool, _page_mem(next), &src,
+                          r.x, r.y, r.w, r.h);
+    }
+    stale->count = 0;
+    bmp->mem = _page_mem(next);
+}
+
+
+static void _draw_frame(bitmap_t* bmp) {
+    _FB.frame_tiles = 0;
+    _FB.frame_tiles_written = 0;
+
+    int page = _direct_page(bmp);
+    if (page >= 0) {
+        _draw_direct(bmp, page);
+        return;
+    }
+    // Pages drawn in place don't match their shadow anymore, and
+    // shadows can't be compared with frames of another storage.
+    if (_FB.direct || bmp->psize != _FB.psize) {
+        _FB.direct = false;
+        _FB.psize = bmp->psize;
+        _invalidate_pages();
+    }
+    _add_stale(bmp);
+
+    if (_FB.page_max == 1) {
+        _update_page(bmp, 0);
+        return;
+    }
+
+    // Render in the next hidden page, then pan to it.
+    int next = (_FB.page + 1) % _FB.page_max;
+    if (!_update_page(bmp, next)) {
+        return;
+    }
+    _FB.var_si.yoffset = next * _FB.var_si.yres;
+    if (ioctl(_FB.fd, FBIOPAN_DISPLAY, &_FB.var_si) < 0) {
+        fprintf(stderr, "Page flipping failed, using a single page\n");
+        jcfb_set_buffering(1);
+        _update_page(bmp, 0);
+        return;
+    }
+    _FB.page = next;
+}
+
+
+// Publish the tile counts of the frame drawn last, which the presenter
+// does with the lock held.
+static void _count_tiles() {
+    _FB.stats.tiles = _FB.frame_tiles;
+    _FB.stats.tiles_written = _FB.frame_tiles_written;
+}
+
+
+// Signal handlers only restore the keyboard and the display mode, with
+// async-signal-safe calls: the presenter and the scanout workers may be
+// holding locks, or be the faulting thread.
 static void _signal_handler(int signo) {
-    jcfb_stop();
+    stop_keyboard();
+    if (_FB.fd >= 0) {
+        ioctl(_FB.fd, FBIOPUT_VSCREENINFO, &_FB.saved_var_si);
+    }
     if (signo == SIGSEGV) {
         signal(SIGSEGV, _sigsegv_handler);
         raise(SIGSEGV);
@@ -84,7 +467,8 @@ int jcfb_start() {
         .fd = -1,
         .mem = NULL,
         .page = 0,
-        .page_max = 0,
+        .page_max = 1,
+        .psize = sizeof(pixel_t),
     };
 
     // Retrieves framebuffer information
@@ -124,6 +508,8 @@ int jcfb_start() {
             [COMP_ALPHA] = var_si.transp.length,
         }
     };
+    // Select the pixel kernels before building the conversion plans
+    simd_init();
     pixfmt_set_fb(&fmt);
     memcpy(&_FB.fmt, &fmt, sizeof(pixfmt_t));
 
@@ -145,11 +531,40 @@ int jcfb_start() {
     }
     memset(_FB.mem, 0, _FB_memsize());
 
+    // Select the scanout kernel matching the framebuffer layout
+    if (scanout_init(&_FB.scanout, var_si.bits_per_pixel,
+                     fix_si.line_length, var_si.xres) < 0) {
+        fprintf(stderr, "Unsupported framebuffer memory layout\n");
+        goto error;
+    }
+
     // Scroll framebuffer to the start of its memory
     _FB.var_si.xoffset = 0;
     _FB.var_si.yoffset = 0;
     ioctl(_FB.fd, FBIOPUT_VSCREENINFO, &_FB.var_si);
 
+    _invalidate_pages();
+
+    // Tile diffing and scanout threads can be enabled without changing
+    // the program
+    const char* tile_size = getenv("JCFB_TILE_DIFF");
+    if (tile_size) {
+        jcfb_set_tile_diff(atoi(tile_size));
+    }
+    pool_init(&_FB.pool, 1, NULL);
+    const char* threads = getenv("JCFB_THREADS");
+    if (threads) {
+        jcfb_set_threads(atoi(threads), NULL);
+    }
+
+    // Frame pacing
+    _FB.has_vsync = true;
+    _FB.period = _refresh_period(&_FB.var_si);
+    _FB.vsync_origin = _now();
+    _FB.deadline = 0;
+    _FB.last_present = 0;
+    _FB.stats = (jcfb_stats_t){0};
+
     // Initialize the keyboard
     if (init_keyboard() < 0) {
         fprintf(stderr, "Unable to initialize the keyboard\n");
@@ -171,7 +586,13 @@ int jcfb_start() {
 
 
 void jcfb_stop() {
+    jcfb_async_stop();
     stop_keyboard();
+    _free_shadows();
+    if (_FB.pool.nthreads) {
+        pool_wipe(&_FB.pool);
+        _FB.pool.nthreads = 0;
+    }
     if (_FB.mem && _FB.mem != MAP_FAILED) {
         munmap(_FB.mem, _FB_memsize());
         _FB.mem = NULL;
@@ -186,6 +607,7 @@ void jcfb_stop() {
 
 void jcfb_clear() {
     memset(_FB.mem, 0, _FB_memsize());
+    _invalidate_pages();
 }
 
 
@@ -194,14 +616,285 @@ int jcfb_get_bitmap(bitmap_t* bmp) {
 }
 
 
+int jcfb_get_direct_bitmap(bitmap_t* bmp) {
+    // Bitmap pixels are stored in the framebuffer format on 2, 3 or 4
+    // bytes, and their rows must be a whole number of pixels apart.
+    int psize = _FB.var_si.bits_per_pixel / 8;
+    if (_FB.var_si.bits_per_pixel % 8 || psize < 2
+    ||  _FB.fix_si.line_length % psize)
+    {
+        return -1;
+    }
+
+    // Every page starts with the visible content.
+    size_t size = _FB.var_si.yres * _FB.fix_si.line_length;
+    for (int p = 0; p < _FB.page_max; p++) {
+        if (p != _FB.page) {
+            memcpy(_page_mem(p), _page_mem(_FB.page), size);
+        }
+        _FB.stale[p].count = 0;
+    }
+    _FB.direct = true;
+
+    int page = (_FB.page + 1) % _FB.page_max;
+    bitmap_init_from_memory(bmp, _FB.var_si.xres, _FB.var_si.yres,
+                            _page_mem(page));
+    bmp->stride = _FB.fix_si.line_length / psize;
+    bmp->psize = psize;
+    return 0;
+}
+
+
+int jcfb_set_buffering(int pages) {
+    pages = clamp(pages, 1, MAX_PAGES);
+    if (pages > 1 && _set_virtual_pages(pages) == 0) {
+        _FB.page = 0;
+        _FB.page_max = pages;
+        _invalidate_pages();
+        return pages;
+    }
+
+    // Copy path: a single page, displayed at the start of the memory.
+    _FB.page = 0;
+    _FB.page_max = 1;
+    _invalidate_pages();
+    if (_set_virtual_pages(1) < 0 && !_FB.mem) {
+        return -1;
+    }
+    return 1;
+}
+
+
+void jcfb_set_tile_diff(int tile_size) {
+    _free_shadows();
+    _FB.tile_size = max(0, tile_size);
+    _invalidate_pages();
+}
+
+
+int jcfb_set_threads(int nthreads, const int* cpus) {
+    // The pool only exists between `jcfb_start()` and `jcfb_stop()`.
+    if (!_FB.pool.nthreads) {
+        return -1;
+    }
+    nthreads = clamp(nthreads, 1, MAX_THREADS);
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 0; cpus && i < nthreads - 1; i++) {
+        if (cpus[i] < 0 || cpus[i] >= ncpus) {
+            return -1;
+        }
+    }
+    pool_wipe(&_FB.pool);
+    if (pool_init(&_FB.pool, nthreads, cpus) < 0) {
+        pool_init(&_FB.pool, 1, NULL);
+        return -1;
+    }
+    return nthreads;
+}
+
+
 void jcfb_refresh(bitmap_t* bmp) {
+    if (bmp) {
+        _draw_frame(bmp);
+        _count_tiles();
+    }
+    update_keyboard();
+}
+
+
+int jcfb_wait_vsync() {
+    if (_FB.has_vsync) {
+        uint32_t crtc = 0;
+        if (ioctl(_FB.fd, FBIO_WAITFORVSYNC, &crtc) == 0) {
+            return 0;
+        }
+        if (errno == EINTR) {
+            return -1;
+        }
+        // No vblank interrupt, use the timer schedule from now on.
+        _FB.has_vsync = false;
+    }
+
+    int64_t now = _now();
+    int64_t ticks = (now - _FB.vsync_origin) / _FB.period + 1;
+    _sleep_until(_FB.vsync_origin + ticks * _FB.period);
+    return 1;
+}
+
+
+// Sleep until the next frame deadline, `interval_us` after the previous
+// one. Returns the number of deadlines missed since the previous frame.
+static int _pace(long interval_us) {
+    int64_t interval = interval_us * (int64_t)1000;
+    if (interval <= 0) {
+        interval = _FB.period;
+    }
+
+    // Count the deadlines the caller missed while rendering, and move
+    // the deadline to the next slot not yet elapsed.
+    int64_t now = _now();
+    int missed = 0;
+    if (!_FB.deadline) {
+        _FB.deadline = now;
+    } else
+    if (now > _FB.deadline) {
+        missed = (now - _FB.deadline) / interval + 1;
+        _FB.deadline += missed * interval;
+    }
+
+    // Sleep close to the deadline, and let the vblank align the frame.
+    if (_FB.has_vsync) {
+        _sleep_until(_FB.deadline - _FB.period / 2);
+        if (jcfb_wait_vsync() < 0) {
+            _sleep_until(_FB.deadline);
+        }
+    } else {
+        _sleep_until(_FB.deadline);
+    }
+    _FB.deadline += interval;
+    return missed;
+}
+
+
+static void _count_frame(int missed) {
+    _count_tiles();
+    int64_t now = _now();
+    if (_FB.last_present) {
+        _FB.stats.frame_us = (now - _FB.last_present) / 1000;
+    }
+    _FB.last_present = now;
+    _FB.stats.frames++;
+    _FB.stats.missed += missed;
+}
+
+
+int jcfb_present(bitmap_t* bmp, long interval_us) {
+    int missed = _pace(interval_us);
     if (bmp) {
         _draw_frame(bmp);
     }
+    _count_frame(missed);
     update_keyboard();
+    return missed;
+}
+
+
+void jcfb_get_stats(jcfb_stats_t* stats) {
+    if (_FB.async) {
+        pthread_mutex_lock(&_FB.lock);
+    }
+    *stats = _FB.stats;
+    if (_FB.async) {
+        pthread_mutex_unlock(&_FB.lock);
+    }
+}
+
+
+// Asynchronous presentation ------------------------------------------
+static void* _presenter(void* arg) {
+    pthread_mutex_lock(&_FB.lock);
+    for (;;) {
+        while (!_FB.pending && !_FB.async_quit) {
+            pthread_cond_wait(&_FB.cond, &_FB.lock);
+        }
+        // The last frame handed over is presented before quitting.
+        if (!_FB.pending) {
+            break;
+        }
+        _FB.presenting = _FB.pending;
+        _FB.pending = NULL;
+        pthread_cond_broadcast(&_FB.cond);
+        pthread_mutex_unlock(&_FB.lock);
+
+        int missed = 0;
+        if (_FB.async_interval >= 0) {
+            missed = _pace(_FB.async_interval);
+        }
+        _draw_frame(_FB.presenting);
+
+        pthread_mutex_lock(&_FB.lock);
+        _count_frame(missed);
+        _FB.presenting = NULL;
+        pthread_cond_broadcast(&_FB.cond);
+    }
+    pthread_mutex_unlock(&_FB.lock);
+    return NULL;
+}
+
+
+bitmap_t* jcfb_async_start(long interval_us) {
+    if (_FB.async) {
+        return NULL;
+    }
+    memset(_FB.buffers, 0, sizeof(_FB.buffers));
+    if (jcfb_get_bitmap(&_FB.buffers[0]) < 0
+    ||  jcfb_get_bitmap(&_FB.buffers[1]) < 0)
+    {
+        goto error;
+    }
+
+    _FB.pending = NULL;
+    _FB.presenting = NULL;
+    _FB.async_quit = false;
+    _FB.async_interval = interval_us;
+    pthread_mutex_init(&_FB.lock, NULL);
+    pthread_cond_init(&_FB.cond, NULL);
+    if (pthread_create(&_FB.presenter, NULL, _presenter, NULL) != 0) {
+        pthread_cond_destroy(&_FB.cond);
+        pthread_mutex_destroy(&_FB.lock);
+        goto error;
+    }
+    _FB.async = true;
+    return &_FB.buffers[0];
+
+  error:
+    bitmap_wipe(&_FB.buffers[0]);
+    bitmap_wipe(&_FB.buffers[1]);
+    return NULL;
+}
+
+
+bitmap_t* jcfb_async_present(bitmap_t* bmp) {
+    assert(bmp == &_FB.buffers[0] || bmp == &_FB.buffers[1]);
+    bitmap_t* other = (bmp == &_FB.buffers[0]) ? &_FB.buffers[1]
+                                               : &_FB.buffers[0];
+
+    // Wait for the presenter to take the previous frame, hand it this
+    // one, and wait until it's done with the other buffer.
+    pthread_mutex_lock(&_FB.lock);
+    while (_FB.pending) {
+        pthread_cond_wait(&_FB.cond, &_FB.lock);
+    }
+    _FB.pending = bmp;
+    pthread_cond_broadcast(&_FB.cond);
+    while (_FB.presenting == other) {
+        pthread_cond_wait(&_FB.cond, &_FB.lock);
+    }
+    pthread_mutex_unlock(&_FB.lock);
+
+    update_keyboard();
+    return other;
+}
+
+
+void jcfb_async_stop() {
+    if (!_FB.async) {
+        return;
+    }
+    pthread_mutex_lock(&_FB.lock);
+    _FB.async_quit = true;
+    pthread_cond_broadcast(&_FB.cond);
+    pthread_mutex_unlock(&_FB.lock);
+    pthread_join(_FB.presenter, NULL);
+    pthread_cond_destroy(&_FB.cond);
+    pthread_mutex_destroy(&_FB.lock);
+    bitmap_wipe(&_FB.buffers[0]);
+    bitmap_wipe(&_FB.buffers[1]);
+    _FB.async = false;
 }
 
 
+// --------------------------------------------------------------------
 int jcfb_width() {
     return _FB.var_si.xres;
 }
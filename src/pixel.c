@@ -1,9 +1,18 @@
 #include <assert.h>
 #include <string.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include "jcfb/pixel.h"
 #include "jcfb/util.h"
 
+#include "simd-internal.h"
+
 
 static pixfmt_t _PIXFMTS[] = {
      [PIXFMT_FB] = {0},
@@ -37,6 +46,9 @@ static pixfmt_t _PIXFMTS[] = {
         .offs = {24, 16, 8, 0},
         .sizes = {8, 8, 8, 8},
      },
+     [PIXFMT_PAL8] = {
+        .bpp = 8,
+     },
 };
 
 
@@ -46,8 +58,28 @@ pixfmt_t pixfmt_get(pixfmt_id_t which) {
 }
 
 
+// Conversion plans, built on first use, and again when the framebuffer
+// format changes. Pool workers may be the first users: the flag is
+// published with release semantics once everything is built.
+static pixconv_plan_t _PLANS[PIXFMT_MAX][PIXFMT_MAX];
+static bool _plans_built = false;
+static void _build_plans();
+static void _init_blend();
+
+// Components of every 8 bits value in each format, built with the plans.
+static pixel_t _CHANNEL_LUTS[PIXFMT_MAX][COMP_MAX][256];
+
+
+static inline void _ensure_plans() {
+    if (!__atomic_load_n(&_plans_built, __ATOMIC_ACQUIRE)) {
+        _build_plans();
+    }
+}
+
+
 void pixfmt_set_fb(const pixfmt_t* fmt) {
     _PIXFMTS[PIXFMT_FB] = *fmt;
+    _build_plans();
 }
 
 
@@ -64,34 +96,36 @@ static uint32_t _comp_conv_32(uint32_t off, uint32_t size,
 }
 
 
+static void _build_channel_luts(pixfmt_id_t fmt_id) {
+    const pixfmt_t* fmt = &_PIXFMTS[fmt_id];
+    for (int c = 0; c < COMP_MAX; c++) {
+        for (int v = 0; v < 256; v++) {
+            _CHANNEL_LUTS[fmt_id][c][v] = _comp_conv_32(fmt->offs[c],
+                                                        fmt->sizes[c], v);
+        }
+    }
+}
+
+
 pixel_t pixel(pixel_t rgba32)
 {
-    static const pixfmt_t* fmt = &_PIXFMTS[PIXFMT_FB];
-    return _comp_conv_32(fmt->offs[0], fmt->sizes[0],
-                         ((rgba32 >> 0 ) & 0xff))
-         | _comp_conv_32(fmt->offs[1], fmt->sizes[1],
-                         ((rgba32 >> 8 ) & 0xff))
-         | _comp_conv_32(fmt->offs[2], fmt->sizes[2],
-                         ((rgba32 >> 16) & 0xff))
-         | _comp_conv_32(fmt->offs[3], fmt->sizes[3],
-                         ((rgba32 >> 24) & 0xff));
+    return pixel_to(PIXFMT_FB, rgba32);
 }
 
 
 pixel_t pixel_to(pixfmt_id_t fmt_id, pixel_t rgba32)
 {
-    const pixfmt_t* fmt = &_PIXFMTS[fmt_id];
-    return _comp_conv_32(fmt->offs[0], fmt->sizes[0],
-                         ((rgba32 >> 0 ) & 0xff))
-         | _comp_conv_32(fmt->offs[1], fmt->sizes[1],
-                         ((rgba32 >> 8 ) & 0xff))
-         | _comp_conv_32(fmt->offs[2], fmt->sizes[2],
-                         ((rgba32 >> 16) & 0xff))
-         | _comp_conv_32(fmt->offs[3], fmt->sizes[3],
-                         ((rgba32 >> 24) & 0xff));
+    _ensure_plans();
+    pixel_t (*luts)[256] = _CHANNEL_LUTS[fmt_id];
+    return luts[0][(rgba32 >> 0 ) & 0xff]
+         | luts[1][(rgba32 >> 8 ) & 0xff]
+         | luts[2][(rgba32 >> 16) & 0xff]
+         | luts[3][(rgba32 >> 24) & 0xff];
 }
 
 
+#ifdef TEST
+// Reference component conversion, conversion plans precompute it.
 static uint32_t _comp_conv(uint32_t in_off, uint32_t in_size,
                            uint32_t out_off, uint32_t out_size,
                            uint32_t in)
@@ -106,19 +140,333 @@ static uint32_t _comp_conv(uint32_t in_off, uint32_t in_size,
 }
 
 
+// Reference additive blend, blend kernels precompute it.
+static pixel_t _blend_add_ref(pixel_t src, pixel_t dst) {
+    int dr, dg, db;
+    int sr, sg, sb;
+    read_rgb(dst, &dr, &dg, &db);
+    read_rgb(src, &sr, &sg, &sb);
+    dr = min(255, dr + sr);
+    dg = min(255, dg + sg);
+    db = min(255, db + sb);
+    return rgb(dr, dg, db);
+}
+
+
+// Reference interpolation of 8 bits components, `b` weighing t / 256.
+static pixel_t _lerp_ref(pixel_t a, pixel_t b, uint32_t t) {
+    pixel_t p = 0;
+    for (int c = 0; c < 32; c += 8) {
+        uint32_t x = a >> c & 0xff, y = b >> c & 0xff;
+        p |= (x * (256 - t) + y * t) >> 8 << c;
+    }
+    return p;
+}
+#endif
+
+
+// Conversion kernels -------------------------------------------------
+static void _row_copy(const pixconv_plan_t* plan, pixel_t* dst,
+                      const pixel_t* src, int n)
+{
+    if (dst != src) {
+        memmove(dst, src, n * sizeof(pixel_t));
+    }
+}
+
+
+// Formats sharing their layout only differ by their unused bits.
+static void _row_mask(const pixconv_plan_t* plan, pixel_t* dst,
+                      const pixel_t* src, int n)
+{
+    pixel_t mask = plan->masks[0] | plan->masks[1]
+                 | plan->masks[2] | plan->masks[3];
+    for (int i = 0; i < n; i++) {
+        dst[i] = src[i] & mask;
+    }
+}
+
+
+static void _row_shift(const pixconv_plan_t* plan, pixel_t* dst,
+                       const pixel_t* src, int n)
+{
+    // Locals let the compiler keep the plan in registers.
+    const uint32_t m0 = plan->masks[0], m1 = plan->masks[1],
+                   m2 = plan->masks[2], m3 = plan->masks[3];
+    const uint32_t l0 = plan->lshifts[0], l1 = plan->lshifts[1],
+                   l2 = plan->lshifts[2], l3 = plan->lshifts[3];
+    const uint32_t r0 = plan->rshifts[0], r1 = plan->rshifts[1],
+                   r2 = plan->rshifts[2], r3 = plan->rshifts[3];
+    for (int i = 0; i < n; i++) {
+        pixel_t p = src[i];
+        dst[i] = (((p & m0) << l0) >> r0) | (((p & m1) << l1) >> r1)
+               | (((p & m2) << l2) >> r2) | (((p & m3) << l3) >> r3);
+    }
+}
+
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static void _row_shift_sse2(const pixconv_plan_t* plan, pixel_t* dst,
+                            const pixel_t* src, int n)
+{
+    __m128i m[COMP_MAX], l[COMP_MAX], r[COMP_MAX];
+    for (int c = 0; c < COMP_MAX; c++) {
+        m[c] = _mm_set1_epi32(plan->masks[c]);
+        l[c] = _mm_cvtsi32_si128(plan->lshifts[c]);
+        r[c] = _mm_cvtsi32_si128(plan->rshifts[c]);
+    }
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i o = _mm_setzero_si128();
+        for (int c = 0; c < COMP_MAX; c++) {
+            __m128i comp = _mm_sll_epi32(_mm_and_si128(p, m[c]), l[c]);
+            o = _mm_or_si128(o, _mm_srl_epi32(comp, r[c]));
+        }
+        _mm_storeu_si128((__m128i*)(dst + i), o);
+    }
+    _row_shift(plan, dst + i, src + i, n - i);
+}
+
+
+// Byte shuffle control moving the bytes of 4 pixels.
+static void _shuffle_control(const pixconv_plan_t* plan, int8_t ctrl[16]) {
+    for (int i = 0; i < 16; i++) {
+        int8_t b = plan->bytes[i % 4];
+        ctrl[i] = b < 0 ? -1 : i / 4 * 4 + b;
+    }
+}
+
+
+__attribute__((target("ssse3")))
+static void _row_shuffle_ssse3(const pixconv_plan_t* plan, pixel_t* dst,
+                               const pixel_t* src, int n)
+{
+    int8_t ctrl[16];
+    _shuffle_control(plan, ctrl);
+    __m128i shuf = _mm_loadu_si128((const __m128i*)ctrl);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_shuffle_epi8(p, shuf));
+    }
+    _row_shift(plan, dst + i, src + i, n - i);
+}
+
+
+__attribute__((target("avx2")))
+static void _row_shift_avx2(const pixconv_plan_t* plan, pixel_t* dst,
+                            const pixel_t* src, int n)
+{
+    __m256i m[COMP_MAX];
+    __m128i l[COMP_MAX], r[COMP_MAX];
+    for (int c = 0; c < COMP_MAX; c++) {
+        m[c] = _mm256_set1_epi32(plan->masks[c]);
+        l[c] = _mm_cvtsi32_si128(plan->lshifts[c]);
+        r[c] = _mm_cvtsi32_si128(plan->rshifts[c]);
+    }
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i p = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i o = _mm256_setzero_si256();
+        for (int c = 0; c < COMP_MAX; c++) {
+            __m256i comp = _mm256_sll_epi32(_mm256_and_si256(p, m[c]), l[c]);
+            o = _mm256_or_si256(o, _mm256_srl_epi32(comp, r[c]));
+        }
+        _mm256_storeu_si256((__m256i*)(dst + i), o);
+    }
+    _row_shift(plan, dst + i, src + i, n - i);
+}
+
+
+__attribute__((target("avx2")))
+static void _row_shuffle_avx2(const pixconv_plan_t* plan, pixel_t* dst,
+                              const pixel_t* src, int n)
+{
+    // The shuffle works on each 128 bits lane.
+    int8_t ctrl[16];
+    _shuffle_control(plan, ctrl);
+    __m256i shuf = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i*)ctrl)
+    );
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i p = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i),
+                            _mm256_shuffle_epi8(p, shuf));
+    }
+    _row_shift(plan, dst + i, src + i, n - i);
+}
+#endif
+
+
+#if defined(__ARM_NEON)
+static void _row_shift_neon(const pixconv_plan_t* plan, pixel_t* dst,
+                            const pixel_t* src, int n)
+{
+    // NEON shifts left by positive and right by negative amounts.
+    uint32x4_t m[COMP_MAX];
+    int32x4_t l[COMP_MAX], r[COMP_MAX];
+    for (int c = 0; c < COMP_MAX; c++) {
+        m[c] = vdupq_n_u32(plan->masks[c]);
+        l[c] = vdupq_n_s32(plan->lshifts[c]);
+        r[c] = vdupq_n_s32(-(int32_t)plan->rshifts[c]);
+    }
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32x4_t p = vld1q_u32(src + i);
+        uint32x4_t o = vdupq_n_u32(0);
+        for (int c = 0; c < COMP_MAX; c++) {
+            uint32x4_t comp = vshlq_u32(vandq_u32(p, m[c]), l[c]);
+            o = vorrq_u32(o, vshlq_u32(comp, r[c]));
+        }
+        vst1q_u32(dst + i, o);
+    }
+    _row_shift(plan, dst + i, src + i, n - i);
+}
+#endif
+
+
+// 16 bits sources only have 65536 values: a lookup in a table of their
+// conversions, built on first use, beats the masks and shifts of the
+// scalar and SSE2 kernels, even on random pixels missing the first level
+// cache. Tables are only published once filled, as threads drawing in
+// parallel may build the same one.
+static pixel_t* _LUT16[PIXFMT_MAX][PIXFMT_MAX];
+
+
+static void _row_lut16(const pixconv_plan_t* plan, pixel_t* dst,
+                       const pixel_t* src, int n)
+{
+    pixel_t** lut = &_LUT16[plan->in_fmt][plan->out_fmt];
+    pixel_t* table = __atomic_load_n(lut, __ATOMIC_ACQUIRE);
+    if (!table) {
+        table = malloc((UINT16_MAX + 1) * sizeof(pixel_t));
+        if (!table) {
+            _row_shift(plan, dst, src, n);
+            return;
+        }
+        for (uint32_t v = 0; v <= UINT16_MAX; v++) {
+            table[v] = pixconv_plan_pixel(plan, v);
+        }
+        pixel_t* built = NULL;
+        if (!__atomic_compare_exchange_n(lut, &built, table, false,
+                                         __ATOMIC_ACQ_REL,
+                                         __ATOMIC_ACQUIRE))
+        {
+            free(table);
+            table = built;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        dst[i] = table[src[i] & UINT16_MAX];
+    }
+}
+
+
+// Plan doing `_comp_conv()` on every component: the bits of the source
+// component which survive the size change are masked, then moved from
+// their source position to their destination one in a single shift.
+static void _init_plan(pixconv_plan_t* plan, pixfmt_id_t in_id,
+                       pixfmt_id_t out_id)
+{
+    const pixfmt_t* in_fmt = &_PIXFMTS[in_id];
+    const pixfmt_t* out_fmt = &_PIXFMTS[out_id];
+    bool same_layout = true;
+    *plan = (pixconv_plan_t){
+        .in_fmt = in_id,
+        .out_fmt = out_id,
+        .bytewise = true,
+        .bytes = {-1, -1, -1, -1},
+    };
+    for (int i = 0; i < COMP_MAX; i++) {
+        int in_size = in_fmt->sizes[i];
+        int out_size = out_fmt->sizes[i];
+        int lost = max(0, in_size - out_size);
+        uint32_t mask = ~(UINT32_MAX << in_size);
+        plan->masks[i] = (mask >> lost << lost) << in_fmt->offs[i];
+        // Dropped components keep null shifts, which could otherwise
+        // reach the width of a pixel.
+        int shift = !plan->masks[i] ? 0
+                  : (int)out_fmt->offs[i] + out_size
+                  - (int)in_fmt->offs[i] - in_size;
+        plan->lshifts[i] = max(0, shift);
+        plan->rshifts[i] = max(0, -shift);
+        same_layout &= in_size == out_size
+                    && (!in_size || in_fmt->offs[i] == out_fmt->offs[i]);
+
+        // Components missing on either side end up as zero bits.
+        if (!in_size || !out_size) {
+            continue;
+        }
+        if (in_size != 8 || out_size != 8
+        ||  in_fmt->offs[i] % 8 || out_fmt->offs[i] % 8)
+        {
+            plan->bytewise = false;
+            continue;
+        }
+        plan->bytes[out_fmt->offs[i] / 8] = in_fmt->offs[i] / 8;
+    }
+    free(_LUT16[in_id][out_id]);
+    _LUT16[in_id][out_id] = NULL;
+    uint32_t in_mask = plan->masks[0] | plan->masks[1]
+                     | plan->masks[2] | plan->masks[3];
+    // AVX2 shifts match the tables on cached entries and beat them on
+    // missed ones. NEON ones are left alone, untested.
+    const simd_kernels_t* kernels = simd_kernels();
+    bool lut16 = in_fmt->bpp == 16 && in_mask <= UINT16_MAX
+              && kernels->level != SIMD_AVX2 && kernels->level != SIMD_NEON;
+    if (in_id == out_id) {
+        plan->row = _row_copy;
+    } else if (same_layout) {
+        plan->row = _row_mask;
+    } else if (lut16) {
+        plan->row = _row_lut16;
+    } else {
+        plan->row = plan->bytewise ? kernels->convert_bytes
+                                   : kernels->convert;
+    }
+}
+
+
+static void _build_plans() {
+    for (int i = 0; i < PIXFMT_MAX; i++) {
+        _build_channel_luts(i);
+        for (int o = 0; o < PIXFMT_MAX; o++) {
+            _init_plan(&_PLANS[i][o], i, o);
+        }
+    }
+    _init_blend();
+    __atomic_store_n(&_plans_built, true, __ATOMIC_RELEASE);
+}
+
+
+const pixconv_plan_t* pixconv_plan_get(pixfmt_id_t in_fmt,
+                                       pixfmt_id_t out_fmt)
+{
+    assert(in_fmt >= 0 && in_fmt < PIXFMT_MAX);
+    assert(out_fmt >= 0 && out_fmt < PIXFMT_MAX);
+    _ensure_plans();
+    return &_PLANS[in_fmt][out_fmt];
+}
+
+
+void pixel_convert_row(pixfmt_id_t in_fmt, pixfmt_id_t out_fmt,
+                       pixel_t* dst, const pixel_t* src, int n)
+{
+    const pixconv_plan_t* plan = pixconv_plan_get(in_fmt, out_fmt);
+    plan->row(plan, dst, src, n);
+}
+
+
 pixel_t pixel_conv(pixfmt_id_t in_fmt_id, pixfmt_id_t out_fmt_id,
                    pixel_t p)
 {
     if (in_fmt_id == out_fmt_id) {
         return p;
     }
-    const pixfmt_t* in_fmt = &_PIXFMTS[in_fmt_id];
-    const pixfmt_t* out_fmt = &_PIXFMTS[out_fmt_id];
-#define CONV(_i) \
-    _comp_conv(in_fmt->offs[_i], in_fmt->sizes[_i], \
-               out_fmt->offs[_i], out_fmt->sizes[_i], p)
-    return CONV(0) | CONV(1) | CONV(2) | CONV(3);
-#undef CONV
+    return pixconv_plan_pixel(pixconv_plan_get(in_fmt_id, out_fmt_id), p);
 }
 
 
@@ -152,15 +500,455 @@ pixel_t get_mask_color() {
 }
 
 
+// Additive blending -------------------------------------------------
+// Pixels are blended in the framebuffer format, each color component
+// added in place and saturated to its mask. Alpha and unused bits end
+// up zero, as with `rgb()`.
+typedef void (*blend_row_func_t)(pixel_t* dst, const pixel_t* src,
+                                 int sstep, int n);
+
+static uint32_t _BLEND_MASKS[COMP_ALPHA];
+static uint32_t _blend_mask;                /* Every color bit */
+static blend_row_func_t _blend_row;
+
+
+static inline pixel_t _blend_pixel(pixel_t a, pixel_t b) {
+    pixel_t out = 0;
+    for (int c = 0; c < COMP_ALPHA; c++) {
+        uint32_t m = _BLEND_MASKS[c];
+        uint64_t sum = (uint64_t)(a & m) + (b & m);
+        out |= sum > m ? m : sum;
+    }
+    return out;
+}
+
+
+static void _blend_row_scalar(pixel_t* dst, const pixel_t* src,
+                              int sstep, int n)
+{
+    for (int i = 0; i < n; i++) {
+        dst[i] = _blend_pixel(dst[i], src[i * sstep]);
+    }
+}
+
+
+#if defined(__x86_64__) || defined(__i386__)
+// 8 bits components: saturating byte additions.
+__attribute__((target("sse2")))
+static void _blend_row_bytes_sse2(pixel_t* dst, const pixel_t* src,
+                                  int sstep, int n)
+{
+    __m128i mask = _mm_set1_epi32(_blend_mask);
+    __m128i color = _mm_set1_epi32(src[0]);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = sstep ? _mm_loadu_si128((const __m128i*)(src + i))
+                          : color;
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        d = _mm_and_si128(_mm_adds_epu8(d, s), mask);
+        _mm_storeu_si128((__m128i*)(dst + i), d);
+    }
+    _blend_row_scalar(dst + i, src + i * sstep, sstep, n - i);
+}
+
+
+// Other components (like RGB16 ones): additions in 32 bits lanes, the
+// components staying below the sign bit.
+__attribute__((target("sse2")))
+static void _blend_row_fields_sse2(pixel_t* dst, const pixel_t* src,
+                                   int sstep, int n)
+{
+    __m128i m[COMP_ALPHA];
+    for (int c = 0; c < COMP_ALPHA; c++) {
+        m[c] = _mm_set1_epi32(_BLEND_MASKS[c]);
+    }
+    __m128i color = _mm_set1_epi32(src[0]);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = sstep ? _mm_loadu_si128((const __m128i*)(src + i))
+                          : color;
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i o = _mm_setzero_si128();
+        for (int c = 0; c < COMP_ALPHA; c++) {
+            __m128i sum = _mm_add_epi32(_mm_and_si128(d, m[c]),
+                                        _mm_and_si128(s, m[c]));
+            __m128i over = _mm_cmpgt_epi32(sum, m[c]);
+            sum = _mm_or_si128(_mm_andnot_si128(over, sum),
+                               _mm_and_si128(over, m[c]));
+            o = _mm_or_si128(o, sum);
+        }
+        _mm_storeu_si128((__m128i*)(dst + i), o);
+    }
+    _blend_row_scalar(dst + i, src + i * sstep, sstep, n - i);
+}
+
+
+__attribute__((target("avx2")))
+static void _blend_row_bytes_avx2(pixel_t* dst, const pixel_t* src,
+                                  int sstep, int n)
+{
+    __m256i mask = _mm256_set1_epi32(_blend_mask);
+    __m256i color = _mm256_set1_epi32(src[0]);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i s = sstep ? _mm256_loadu_si256((const __m256i*)(src + i))
+                          : color;
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        d = _mm256_and_si256(_mm256_adds_epu8(d, s), mask);
+        _mm256_storeu_si256((__m256i*)(dst + i), d);
+    }
+    _blend_row_scalar(dst + i, src + i * sstep, sstep, n - i);
+}
+
+
+__attribute__((target("avx2")))
+static void _blend_row_fields_avx2(pixel_t* dst, const pixel_t* src,
+                                   int sstep, int n)
+{
+    __m256i m[COMP_ALPHA];
+    for (int c = 0; c < COMP_ALPHA; c++) {
+        m[c] = _mm256_set1_epi32(_BLEND_MASKS[c]);
+    }
+    __m256i color = _mm256_set1_epi32(src[0]);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i s = sstep ? _mm256_loadu_si256((const __m256i*)(src + i))
+                          : color;
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i o = _mm256_setzero_si256();
+        for (int c = 0; c < COMP_ALPHA; c++) {
+            __m256i sum = _mm256_add_epi32(_mm256_and_si256(d, m[c]),
+                                           _mm256_and_si256(s, m[c]));
+            o = _mm256_or_si256(o, _mm256_min_epu32(sum, m[c]));
+        }
+        _mm256_storeu_si256((__m256i*)(dst + i), o);
+    }
+    _blend_row_scalar(dst + i, src + i * sstep, sstep, n - i);
+}
+#endif
+
+
+#if defined(__ARM_NEON)
+static void _blend_row_bytes_neon(pixel_t* dst, const pixel_t* src,
+                                  int sstep, int n)
+{
+    uint8x16_t mask = vreinterpretq_u8_u32(vdupq_n_u32(_blend_mask));
+    uint8x16_t color = vreinterpretq_u8_u32(vdupq_n_u32(src[0]));
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint8x16_t s = sstep ? vreinterpretq_u8_u32(vld1q_u32(src + i))
+                             : color;
+        uint8x16_t d = vreinterpretq_u8_u32(vld1q_u32(dst + i));
+        d = vandq_u8(vqaddq_u8(d, s), mask);
+        vst1q_u32(dst + i, vreinterpretq_u32_u8(d));
+    }
+    _blend_row_scalar(dst + i, src + i * sstep, sstep, n - i);
+}
+
+
+static void _blend_row_fields_neon(pixel_t* dst, const pixel_t* src,
+                                   int sstep, int n)
+{
+    uint32x4_t m[COMP_ALPHA];
+    for (int c = 0; c < COMP_ALPHA; c++) {
+        m[c] = vdupq_n_u32(_BLEND_MASKS[c]);
+    }
+    uint32x4_t color = vdupq_n_u32(src[0]);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32x4_t s = sstep ? vld1q_u32(src + i) : color;
+        uint32x4_t d = vld1q_u32(dst + i);
+        uint32x4_t o = vdupq_n_u32(0);
+        for (int c = 0; c < COMP_ALPHA; c++) {
+            uint32x4_t sum = vaddq_u32(vandq_u32(d, m[c]),
+                                       vandq_u32(s, m[c]));
+            o = vorrq_u32(o, vminq_u32(sum, m[c]));
+        }
+        vst1q_u32(dst + i, o);
+    }
+    _blend_row_scalar(dst + i, src + i * sstep, sstep, n - i);
+}
+#endif
+
+
+static void _init_blend() {
+    const pixfmt_t* fmt = &_PIXFMTS[PIXFMT_FB];
+    bool bytes = true;
+    _blend_mask = 0;
+    for (int c = 0; c < COMP_ALPHA; c++) {
+        _BLEND_MASKS[c] = ~(UINT32_MAX << fmt->sizes[c]) << fmt->offs[c];
+        _blend_mask |= _BLEND_MASKS[c];
+        bytes &= fmt->sizes[c] == 8 && fmt->offs[c] % 8 == 0;
+    }
+    // Vector additions of other components must not carry out of their
+    // 32 bits lane, nor reach the sign bit of signed comparisons.
+    bool fields = !(_blend_mask >> 30);
+    const simd_kernels_t* kernels = simd_kernels();
+    _blend_row = bytes ? kernels->blend_bytes
+               : fields ? kernels->blend_fields
+               : _blend_row_scalar;
+}
+
+
 pixel_t pixel_blend_add(pixel_t src, pixel_t dst) {
-    int dr, dg, db;
-    int sr, sg, sb;
-    read_rgb(dst, &dr, &dg, &db);
-    read_rgb(src, &sr, &sg, &sb);
-    dr = min(255, dr + sr);
-    dg = min(255, dg + sg);
-    db = min(255, db + sb);
-    return rgb(dr, dg, db);
+    _ensure_plans();
+    return _blend_pixel(dst, src);
+}
+
+
+void pixel_blend_add_row(pixel_t* dst, const pixel_t* src, int n) {
+    _ensure_plans();
+    _blend_row(dst, src, 1, n);
+}
+
+
+void pixel_blend_add_fill(pixel_t* dst, pixel_t color, int n) {
+    _ensure_plans();
+    _blend_row(dst, &color, 0, n);
+}
+
+
+// Alpha compositing -------------------------------------------------
+// Sources are converted by chunks before being composited.
+#define OVER_CHUNK 64
+
+
+// `x * t / 255`, rounded.
+static inline uint32_t _mul255(uint32_t x, uint32_t t) {
+    uint32_t p = x * t + 128;
+    return (p + (p >> 8)) >> 8;
+}
+
+
+// Transparency of a source pixel, on 8 bits.
+static inline uint32_t _transparency(const pixfmt_t* fmt, pixel_t p) {
+    uint32_t size = fmt->sizes[COMP_ALPHA];
+    uint32_t max = ~(UINT32_MAX << size);
+    uint32_t a = (p >> fmt->offs[COMP_ALPHA]) & max;
+    return size >= 8 ? a >> (size - 8) : a * 255 / max;
+}
+
+
+// Destination colors fade with the source transparency, then receive
+// the (premultiplied) source colors. Transparencies multiply.
+static void _over_row_scalar(const pixconv_plan_t* plan, pixel_t* dst,
+                             const pixel_t* src, const pixel_t* conv,
+                             int n)
+{
+    const pixfmt_t* in_fmt = &_PIXFMTS[plan->in_fmt];
+    const pixfmt_t* out_fmt = &_PIXFMTS[plan->out_fmt];
+    uint32_t maxs[COMP_MAX];
+    for (int c = 0; c < COMP_MAX; c++) {
+        maxs[c] = ~(UINT32_MAX << out_fmt->sizes[c]);
+    }
+    for (int i = 0; i < n; i++) {
+        uint32_t t = _transparency(in_fmt, src[i]);
+        if (t == 255) {
+            continue;
+        }
+        if (t == 0) {
+            dst[i] = conv[i];
+            continue;
+        }
+        pixel_t out = 0;
+        for (int c = 0; c < COMP_MAX; c++) {
+            uint32_t off = out_fmt->offs[c];
+            uint32_t d = _mul255((dst[i] >> off) & maxs[c], t);
+            if (c != COMP_ALPHA) {
+                d = min(maxs[c], d + ((conv[i] >> off) & maxs[c]));
+            }
+            out |= d << off;
+        }
+        dst[i] = out;
+    }
+}
+
+
+#if defined(__x86_64__) || defined(__i386__)
+// 8 bits components, 4 pixels at once: bytes are multiplied on 16 bits
+// lanes. Groups of transparent or opaque pixels are skipped or copied.
+__attribute__((target("sse2")))
+static inline __m128i _div255_sse2(__m128i x) {
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+
+__attribute__((target("sse2")))
+static void _over_row_sse2(const pixconv_plan_t* plan, pixel_t* dst,
+                           const pixel_t* src, const pixel_t* conv,
+                           int n)
+{
+    const pixfmt_t* in_fmt = &_PIXFMTS[plan->in_fmt];
+    const pixfmt_t* out_fmt = &_PIXFMTS[plan->out_fmt];
+    __m128i ashift = _mm_cvtsi32_si128(in_fmt->offs[COMP_ALPHA]);
+    __m128i byte = _mm_set1_epi32(0xff);
+    __m128i zero = _mm_setzero_si128();
+    uint32_t color_mask = 0;
+    for (int c = 0; c < COMP_ALPHA; c++) {
+        color_mask |= ~(UINT32_MAX << out_fmt->sizes[c])
+                   << out_fmt->offs[c];
+    }
+    __m128i colors = _mm_set1_epi32(color_mask);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i t = _mm_and_si128(_mm_srl_epi32(s, ashift), byte);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(t, byte)) == 0xffff) {
+            continue;
+        }
+        __m128i c = _mm_loadu_si128((const __m128i*)(conv + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(t, zero)) == 0xffff) {
+            _mm_storeu_si128((__m128i*)(dst + i), c);
+            continue;
+        }
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i tt = _mm_or_si128(t, _mm_slli_epi32(t, 16));
+        __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(d, zero),
+                                     _mm_unpacklo_epi32(tt, tt));
+        __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(d, zero),
+                                     _mm_unpackhi_epi32(tt, tt));
+        d = _mm_packus_epi16(_div255_sse2(lo), _div255_sse2(hi));
+        d = _mm_adds_epu8(d, _mm_and_si128(c, colors));
+        _mm_storeu_si128((__m128i*)(dst + i), d);
+    }
+    _over_row_scalar(plan, dst + i, src + i, conv + i, n - i);
+}
+
+
+__attribute__((target("avx2")))
+static inline __m256i _div255_avx2(__m256i x) {
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)),
+                             8);
+}
+
+
+__attribute__((target("avx2")))
+static void _over_row_avx2(const pixconv_plan_t* plan, pixel_t* dst,
+                           const pixel_t* src, const pixel_t* conv,
+                           int n)
+{
+    const pixfmt_t* in_fmt = &_PIXFMTS[plan->in_fmt];
+    const pixfmt_t* out_fmt = &_PIXFMTS[plan->out_fmt];
+    __m128i ashift = _mm_cvtsi32_si128(in_fmt->offs[COMP_ALPHA]);
+    __m256i byte = _mm256_set1_epi32(0xff);
+    __m256i zero = _mm256_setzero_si256();
+    uint32_t color_mask = 0;
+    for (int c = 0; c < COMP_ALPHA; c++) {
+        color_mask |= ~(UINT32_MAX << out_fmt->sizes[c])
+                   << out_fmt->offs[c];
+    }
+    __m256i colors = _mm256_set1_epi32(color_mask);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i t = _mm256_and_si256(_mm256_srl_epi32(s, ashift), byte);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(t, byte)) == -1) {
+            continue;
+        }
+        __m256i c = _mm256_loadu_si256((const __m256i*)(conv + i));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(t, zero)) == -1) {
+            _mm256_storeu_si256((__m256i*)(dst + i), c);
+            continue;
+        }
+        // Unpacks and packs work within 128 bits lanes, which keeps
+        // the pixels in order.
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i tt = _mm256_or_si256(t, _mm256_slli_epi32(t, 16));
+        __m256i lo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero),
+                                        _mm256_unpacklo_epi32(tt, tt));
+        __m256i hi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero),
+                                        _mm256_unpackhi_epi32(tt, tt));
+        d = _mm256_packus_epi16(_div255_avx2(lo), _div255_avx2(hi));
+        d = _mm256_adds_epu8(d, _mm256_and_si256(c, colors));
+        _mm256_storeu_si256((__m256i*)(dst + i), d);
+    }
+    _over_row_scalar(plan, dst + i, src + i, conv + i, n - i);
+}
+#endif
+
+
+// Whether the vector kernels handle the plan's formats.
+static bool _over_bytes(const pixconv_plan_t* plan) {
+    const pixfmt_t* in_fmt = &_PIXFMTS[plan->in_fmt];
+    const pixfmt_t* out_fmt = &_PIXFMTS[plan->out_fmt];
+    if (in_fmt->sizes[COMP_ALPHA] != 8
+    ||  in_fmt->offs[COMP_ALPHA] % 8)
+    {
+        return false;
+    }
+    for (int c = 0; c < COMP_MAX; c++) {
+        if (out_fmt->sizes[c]
+        &&  (out_fmt->sizes[c] != 8 || out_fmt->offs[c] % 8))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void pixel_blend_over_row(const pixconv_plan_t* plan, pixel_t* dst,
+                          const pixel_t* src, int n)
+{
+    if (!_PIXFMTS[plan->in_fmt].sizes[COMP_ALPHA]) {
+        plan->row(plan, dst, src, n);
+        return;
+    }
+    void (*over)(const pixconv_plan_t*, pixel_t*, const pixel_t*,
+                 const pixel_t*, int) = _over_row_scalar;
+    if (_over_bytes(plan)) {
+        over = simd_kernels()->over_bytes;
+    }
+    pixel_t conv[OVER_CHUNK];
+    for (int i = 0; i < n; i += OVER_CHUNK) {
+        int k = min(n - i, OVER_CHUNK);
+        plan->row(plan, conv, src + i, k);
+        over(plan, dst + i, src + i, conv, k);
+    }
+}
+
+
+// Kernel tables ------------------------------------------------------
+void pixel_fill_kernels(simd_kernels_t* table) {
+    table->convert = _row_shift;
+    table->convert_bytes = _row_shift;
+    table->blend_bytes = _blend_row_scalar;
+    table->blend_fields = _blend_row_scalar;
+    table->over_bytes = _over_row_scalar;
+    switch (table->level) {
+#if defined(__x86_64__) || defined(__i386__)
+      case SIMD_SSE2:
+      case SIMD_SSSE3:
+        table->convert = _row_shift_sse2;
+        table->convert_bytes = table->level == SIMD_SSSE3
+                             ? _row_shuffle_ssse3 : _row_shift_sse2;
+        table->blend_bytes = _blend_row_bytes_sse2;
+        table->blend_fields = _blend_row_fields_sse2;
+        table->over_bytes = _over_row_sse2;
+        break;
+      case SIMD_AVX2:
+        table->convert = _row_shift_avx2;
+        table->convert_bytes = _row_shuffle_avx2;
+        table->blend_bytes = _blend_row_bytes_avx2;
+        table->blend_fields = _blend_row_fields_avx2;
+        table->over_bytes = _over_row_avx2;
+        break;
+#endif
+#if defined(__ARM_NEON)
+      case SIMD_NEON:
+        table->convert = _row_shift_neon;
+        table->convert_bytes = _row_shift_neon;
+        table->blend_bytes = _blend_row_bytes_neon;
+        table->blend_fields = _blend_row_fields_neon;
+        break;
+#endif
+      default:
+        break;
+    }
+    // Plans and blending keep the kernels they were built with.
+    __atomic_store_n(&_plans_built, false, __ATOMIC_RELEASE);
 }
 
 
@@ -196,6 +984,56 @@ int main(void) {
     // Pixels beyond 0xffff should be zero
     assert((dst & 0xffff0000) == 0);
 
+    // TEST conversion plans against _comp_conv
+    pixfmt_set_fb(&_PIXFMTS[PIXFMT_RGB16]);
+    for (int i = 0; i < PIXFMT_MAX; i++) {
+        for (int o = 0; o < PIXFMT_MAX; o++) {
+            const pixfmt_t* in_fmt = &_PIXFMTS[i];
+            const pixfmt_t* out_fmt = &_PIXFMTS[o];
+            for (pixel_t p = 0x01234567; p < 0xf0000000; p += 0x0f0e0d0b) {
+                pixel_t expected = 0;
+                for (int c = 0; c < COMP_MAX; c++) {
+                    expected |= _comp_conv(in_fmt->offs[c], in_fmt->sizes[c],
+                                           out_fmt->offs[c],
+                                           out_fmt->sizes[c], p);
+                }
+                pixel_t row[1];
+                pixel_convert_row(i, o, row, &p, 1);
+                assert(i == o || pixel_conv(i, o, p) == expected);
+                assert(i == o || row[0] == expected);
+            }
+        }
+    }
+
+    // TEST every supported kernel against _comp_conv, on rows long
+    // enough to go through both the vector loops and their tails
+    for (int k = 0; k < SIMD_LEVEL_MAX; k++) {
+        if (simd_set_level(k) < 0) {
+            continue;
+        }
+        for (int i = 0; i < PIXFMT_MAX; i++) {
+            for (int o = 0; o < PIXFMT_MAX; o++) {
+                const pixfmt_t* in_fmt = &_PIXFMTS[i];
+                const pixfmt_t* out_fmt = &_PIXFMTS[o];
+                pixel_t row[37], out[37];
+                for (int x = 0; x < 37; x++) {
+                    row[x] = 0x9e3779b9 * (x + 1);
+                }
+                pixel_convert_row(i, o, out, row, 37);
+                for (int x = 0; i != o && x < 37; x++) {
+                    pixel_t expected = 0;
+                    for (int c = 0; c < COMP_MAX; c++) {
+                        expected |= _comp_conv(
+                            in_fmt->offs[c], in_fmt->sizes[c],
+                            out_fmt->offs[c], out_fmt->sizes[c], row[x]
+                        );
+                    }
+                    assert(out[x] == expected);
+                }
+            }
+        }
+    }
+
     // TEST pixel_conv
     src = 0x04c08040;
     dst = pixel_conv(PIXFMT_RGB24, PIXFMT_RGB16, src);
@@ -204,6 +1042,134 @@ int main(void) {
     assert(((dst >> 11) & 0x1f) == 0x18);
     assert((dst & 0xffff0000) == 0);
 
+    // TEST the clear, mask, scale, lerp, scale_lerp and box kernels of
+    // every instruction set
+    for (int l = 0; l < SIMD_LEVEL_MAX; l++) {
+        if (simd_set_level(l) < 0) {
+            continue;
+        }
+        const simd_kernels_t* kernels = simd_kernels();
+        pixel_t row[37], out[37], other[37];
+        int cols[37];
+        for (int x = 0; x < 37; x++) {
+            row[x] = x % 3 ? 0x9e3779b9 * (x + 1) : get_mask_color();
+            other[x] = 0x7f4a7c15u * (x + 3);
+            cols[x] = 36 - x;
+        }
+        kernels->clear(out, 0x00abcdef, 37);
+        kernels->mask(out, row, get_mask_color(), 37);
+        for (int x = 0; x < 37; x++) {
+            assert(out[x] == (x % 3 ? row[x] : 0x00abcdef));
+        }
+        kernels->scale(out, row, cols, 37);
+        for (int x = 0; x < 37; x++) {
+            assert(out[x] == row[36 - x]);
+        }
+        uint8_t w[37];
+        for (int x = 0; x < 37; x++) {
+            w[x] = x * 7;
+        }
+        for (int t = 0; t < 256; t += 200) {
+            kernels->lerp(out, row, other, t, 37);
+            for (int x = 0; x < 37; x++) {
+                assert(out[x] == _lerp_ref(row[x], other[x], t));
+            }
+        }
+        // Enlarged, then reduced
+        for (int x = 0; x < 36; x++) {
+            cols[x] = x < 16 ? x / 2 : 8 + (x - 16) * 7 / 5;
+        }
+        uint32_t map[SIMD_LERP_MAP_SIZE(36) / sizeof(uint32_t)];
+        if (kernels->scale_lerp_map) {
+            kernels->scale_lerp_map(map, cols, w, 36);
+        }
+        kernels->scale_lerp(out, row, cols, w, map, 36);
+        for (int x = 0; x < 36; x++) {
+            assert(out[x] == _lerp_ref(row[cols[x]], row[cols[x] + 1], w[x]));
+        }
+        kernels->box(out, row, other, 18);
+        for (int x = 0; x < 18; x++) {
+            for (int c = 0; c < 32; c += 8) {
+                uint32_t p[4] = {
+                    row[2 * x] >> c & 0xff, row[2 * x + 1] >> c & 0xff,
+                    other[2 * x] >> c & 0xff, other[2 * x + 1] >> c & 0xff,
+                };
+                uint32_t even = (p[0] + p[2] + 1) / 2;
+                uint32_t odd = (p[1] + p[3] + 1) / 2;
+                assert((out[x] >> c & 0xff) == (even + odd + 1) / 2);
+            }
+        }
+    }
+
+    // TEST pixel_blend_add, and its row kernels, against the addition
+    // of RGB24 components
+    for (int f = PIXFMT_RGB16; f < PIXFMT_PAL8; f++) {
+        pixfmt_t fb = pixfmt_get(f);
+        pixfmt_set_fb(&fb);
+        for (int k = 0; k < SIMD_LEVEL_MAX; k++) {
+            if (simd_set_level(k) < 0) {
+                continue;
+            }
+            pixel_t a[37], b[37], row[37], fill[37];
+            for (int x = 0; x < 37; x++) {
+                a[x] = row[x] = fill[x] = 0x9e3779b9 * (x + 1);
+                b[x] = 0x7f4a7c15u * (x + 3);
+            }
+            pixel_blend_add_row(row, b, 37);
+            pixel_blend_add_fill(fill, b[5], 37);
+            for (int x = 0; x < 37; x++) {
+                pixel_t expected = _blend_add_ref(b[x], a[x]);
+                assert(pixel_blend_add(b[x], a[x]) == expected);
+                assert(row[x] == expected);
+                assert(fill[x] == _blend_add_ref(b[5], a[x]));
+            }
+        }
+    }
+
+    // TEST pixel_blend_over_row: a half transparent red over white
+    simd_set_level(SIMD_SCALAR);
+    dst = 0x00ffffff;
+    src = 0x8000007f;
+    pixel_blend_over_row(pixconv_plan_get(PIXFMT_RGBA32, PIXFMT_RGBA32),
+                         &dst, &src, 1);
+    assert(dst == 0x008080ff);
+    dst = 0x00ffffff;
+    pixel_blend_over_row(pixconv_plan_get(PIXFMT_RGBA32, PIXFMT_RGB24),
+                         &dst, &src, 1);
+    assert(dst == 0x00ff8080);
+
+    // TEST pixel_blend_over_row kernels against the scalar one, on
+    // groups of transparent, opaque and mixed pixels
+    for (int i = PIXFMT_RGBA32; i < PIXFMT_PAL8; i++) {
+        for (int o = PIXFMT_RGB16; o < PIXFMT_PAL8; o++) {
+            const pixconv_plan_t* plan = pixconv_plan_get(i, o);
+            pixel_t srcs[37], dsts[37], expected[37];
+            for (int x = 0; x < 37; x++) {
+                pixel_t rgba = 0x9e3779b9 * (x + 1);
+                int alpha = x < 8 ? 0xff : x < 16 ? 0 : rgba >> 24;
+                int opacity = 0xff - alpha;
+                pixel_t premul = (pixel_t)alpha << 24;
+                for (int c = 0; c < 24; c += 8) {
+                    premul |= _mul255((rgba >> c) & 0xff, opacity) << c;
+                }
+                srcs[x] = pixel_conv(PIXFMT_RGBA32, i, premul);
+                dsts[x] = pixel_conv(PIXFMT_RGBA32, o, 0x7f4a7c15u * x);
+            }
+            memcpy(expected, dsts, sizeof(dsts));
+            simd_set_level(SIMD_SCALAR);
+            pixel_blend_over_row(plan, expected, srcs, 37);
+            for (int k = 0; k < SIMD_LEVEL_MAX; k++) {
+                if (simd_set_level(k) < 0) {
+                    continue;
+                }
+                pixel_t out[37];
+                memcpy(out, dsts, sizeof(dsts));
+                pixel_blend_over_row(pixconv_plan_get(i, o), out, srcs, 37);
+                assert(!memcmp(out, expected, sizeof(out)));
+            }
+        }
+    }
+
     return 0;
 }
 
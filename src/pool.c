@@ -0,0 +1,124 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdlib.h>
+
+
+#include "jcfb/pool.h"
+
+
+// Run jobs until there is none left.
+static void _work(pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->next_job < pool->njobs) {
+        int job = pool->next_job++;
+        pthread_mutex_unlock(&pool->lock);
+        pool->func(pool->arg, job);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0) {
+            pthread_cond_broadcast(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+
+static void* _worker(void* arg) {
+    pool_t* pool = arg;
+    unsigned generation = 0;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->generation == generation && !pool->quit) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->quit) {
+            break;
+        }
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+        _work(pool);
+        pthread_mutex_lock(&pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+
+int pool_init(pool_t* pool, int nthreads, const int* cpus) {
+    *pool = (pool_t){
+        .nthreads = 1,
+        .workers = NULL,
+    };
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    if (nthreads <= 1) {
+        return 0;
+    }
+
+    pool->workers = calloc(nthreads - 1, sizeof(pthread_t));
+    if (!pool->workers) {
+        goto error;
+    }
+    for (int i = 0; i < nthreads - 1; i++) {
+        if (pthread_create(&pool->workers[i], NULL, _worker, pool) != 0) {
+            goto error;
+        }
+        pool->nthreads++;
+        if (cpus) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[i], &set);
+            pthread_setaffinity_np(pool->workers[i], sizeof(set), &set);
+        }
+    }
+    return 0;
+
+  error:
+    pool_wipe(pool);
+    return -1;
+}
+
+
+void pool_wipe(pool_t* pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->nthreads - 1; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+    free(pool->workers);
+    pool->workers = NULL;
+    pool->nthreads = 1;
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+
+void pool_run(pool_t* pool, pool_func_t func, void* arg, int njobs) {
+    if (pool->nthreads <= 1) {
+        for (int job = 0; job < njobs; job++) {
+            func(arg, job);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->func = func;
+    pool->arg = arg;
+    pool->njobs = njobs;
+    pool->next_job = 0;
+    pool->pending = njobs;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    _work(pool);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
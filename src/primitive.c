@@ -1,5 +1,9 @@
+#include <string.h>
+
+
 #include "jcfb/util.h"
 #include "jcfb/primitive.h"
+#include "jcfb/simd.h"
 
 
 static bool _is_point_in_circle(int cx, int cy, int r, int x, int y) {
@@ -9,11 +13,23 @@ static bool _is_point_in_circle(int cx, int cy, int r, int x, int y) {
 }
 
 
+// Returns true if position `length` of a dashed line is in a dash of the
+// first color.
+static bool _is_first_dash(int length, int dash_length) {
+    return length % (2 * dash_length) < dash_length;
+}
+
+
 #define PRIMITIVE_PIXEL_FUNC(_dst, _src) _dst = _src
+#define PRIMITIVE_FILL_FUNC(_dst, _color, _n) \
+    simd_kernels()->clear(_dst, _color, _n)
 #define PRIMITIVE_FUNC_SUFFIX
+#define PRIMITIVE_SET
 #include "primitive.inc.c"
 
 
 #define PRIMITIVE_PIXEL_FUNC(_dst, _src) _dst = pixel_blend_add(_dst, _src)
+#define PRIMITIVE_FILL_FUNC(_dst, _color, _n) \
+    pixel_blend_add_fill(_dst, _color, _n)
 #define PRIMITIVE_FUNC_SUFFIX _blend_add
 #include "primitive.inc.c"
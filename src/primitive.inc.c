@@ -6,40 +6,150 @@
     #error "undefined PRIMITIVE_FUNC_SUFFIX"
 #endif
 
+// Optional drawing of `_n` contiguous 32 bits pixels, for operations
+// having a row kernel.
+//   PRIMITIVE_FILL_FUNC(_dst, _color, _n)
+
+// Defined for operations storing the color whatever the pixel under it,
+// which lets packed spans be filled without reading them.
+//   PRIMITIVE_SET
+
 
 #define __TCONCAT(x, y) x ## y
 #define _TCONCAT(x, y) __TCONCAT(x, y)
 #define FUNC(_name) _TCONCAT(_name, PRIMITIVE_FUNC_SUFFIX)
 
 
-void FUNC(draw_hline)(bitmap_t* bmp, pixel_t color, int x1, int x2, int y) {
-    if (y < 0 || y >= bmp->h || color == get_mask_color()) {
+// Draw pixel (x, y) of the clip rectangle, whatever the bitmap's
+// storage.
+static inline void FUNC(_plot)(bitmap_t* bmp, int x, int y, pixel_t color) {
+    if (bmp->psize == sizeof(pixel_t)) {
+        PRIMITIVE_PIXEL_FUNC(bmp->mem[y * bmp->stride + x], color);
+        return;
+    }
+    void* addr = bitmap_addr(bmp, x, y);
+    pixel_t p = pixel_load(addr, bmp->psize);
+    PRIMITIVE_PIXEL_FUNC(p, color);
+    pixel_store(addr, bmp->psize, p);
+}
+
+
+// Packed storage -----------------------------------------------------
+// Draw `n` pixels of `psize` bytes, `step` bytes apart. Inlined with
+// constant sizes, so that each storage width gets its own loop.
+__attribute__((always_inline))
+static inline void FUNC(_fill_packed_n)(uint8_t* d, int psize, int step,
+                                        pixel_t color, int n)
+{
+    for (int i = 0; i < n; i++) {
+        pixel_t p = pixel_load(d, psize);
+        PRIMITIVE_PIXEL_FUNC(p, color);
+        pixel_store(d, psize, p);
+        d += step;
+    }
+}
+
+
+static void FUNC(_fill_packed)(uint8_t* d, int psize, int step,
+                               pixel_t color, int n)
+{
+#ifdef PRIMITIVE_SET
+    // Rows are set at once: bytes with a memset, wider pixels by
+    // doubling the filled part.
+    if (step == psize && n > 0) {
+        if (psize == 1) {
+            memset(d, color, n);
+            return;
+        }
+        pixel_store(d, psize, color);
+        for (int k = 1; k < n; k *= 2) {
+            memcpy(d + k * psize, d, min(k, n - k) * psize);
+        }
         return;
     }
-    int x_min = max(min(x1, x2), 0);
-    int x_max = min(max(x1, x2), bmp->w - 1);
-    pixel_t* addr = bitmap_pixel_addr(bmp, x_min, y);
-    for (int x = x_min; x <= x_max; x++) {
+#endif
+#define CASE(_s) \
+      case _s: \
+        FUNC(_fill_packed_n)(d, _s, step, color, n); \
+        break;
+    switch (psize) {
+      CASE(1) CASE(2) CASE(3)
+      default:
+        FUNC(_fill_packed_n)(d, psize, step, color, n);
+        break;
+    }
+#undef CASE
+}
+
+
+// Draw `n` pixels of row `y` from `x`, all in the clip rectangle.
+static void FUNC(_fill_span)(bitmap_t* bmp, pixel_t color, int x, int y,
+                             int n)
+{
+    if (bmp->psize != sizeof(pixel_t)) {
+        FUNC(_fill_packed)(bitmap_addr(bmp, x, y), bmp->psize, bmp->psize,
+                           color, n);
+        return;
+    }
+    pixel_t* addr = bitmap_pixel_addr(bmp, x, y);
+#ifdef PRIMITIVE_FILL_FUNC
+    PRIMITIVE_FILL_FUNC(addr, color, n);
+    return;
+#endif
+    for (int i = 0; i < n; i++) {
         PRIMITIVE_PIXEL_FUNC(*addr, color);
         addr++;
     }
 }
 
 
-void FUNC(draw_vline)(bitmap_t* bmp, pixel_t color, int x, int y1, int y2) {
-    if (x < 0 || x >= bmp->w || color == get_mask_color()) {
+// Draw `n` pixels of column `x` from `y`, all in the clip rectangle.
+static void FUNC(_fill_column)(bitmap_t* bmp, pixel_t color, int x, int y,
+                               int n)
+{
+    if (bmp->psize != sizeof(pixel_t)) {
+        FUNC(_fill_packed)(bitmap_addr(bmp, x, y), bmp->psize,
+                           bmp->stride * bmp->psize, color, n);
         return;
     }
-    int y_min = max(min(y1, y2), 0);
-    int y_max = min(max(y1, y2), bmp->h - 1);
-    pixel_t* addr = bitmap_pixel_addr(bmp, x, y_min);
-    for (int y = y_min; y <= y_max; y++) {
+    pixel_t* addr = bitmap_pixel_addr(bmp, x, y);
+    for (int i = 0; i < n; i++) {
         PRIMITIVE_PIXEL_FUNC(*addr, color);
-        addr += bmp->w;
+        addr += bmp->stride;
     }
 }
 
 
+void FUNC(draw_hline)(bitmap_t* bmp, pixel_t color, int x1, int x2, int y) {
+    rect_t c = bmp->clip;
+    if (y < c.y || y >= c.y + c.h || color == get_mask_color()) {
+        return;
+    }
+    int x_min = max(min(x1, x2), c.x);
+    int x_max = min(max(x1, x2), c.x + c.w - 1);
+    if (x_min > x_max) {
+        return;
+    }
+    bitmap_add_damage(bmp, x_min, y, x_max - x_min + 1, 1);
+    FUNC(_fill_span)(bmp, color, x_min, y, x_max - x_min + 1);
+}
+
+
+void FUNC(draw_vline)(bitmap_t* bmp, pixel_t color, int x, int y1, int y2) {
+    rect_t c = bmp->clip;
+    if (x < c.x || x >= c.x + c.w || color == get_mask_color()) {
+        return;
+    }
+    int y_min = max(min(y1, y2), c.y);
+    int y_max = min(max(y1, y2), c.y + c.h - 1);
+    if (y_min > y_max) {
+        return;
+    }
+    bitmap_add_damage(bmp, x, y_min, 1, y_max - y_min + 1);
+    FUNC(_fill_column)(bmp, color, x, y_min, y_max - y_min + 1);
+}
+
+
 void FUNC(draw_rect)(bitmap_t* bmp, pixel_t color, int x1, int y1,
                                                    int x2, int y2)
 {
@@ -57,24 +167,35 @@ void FUNC(draw_rect)(bitmap_t* bmp, pixel_t color, int x1, int y1,
 void FUNC(fill_rect)(bitmap_t* bmp, pixel_t color, int x1, int y1,
                                                    int x2, int y2)
 {
-    int y_min = min(y1, y2);
-    int y_max = max(y1, y2);
-    for (int y = y_min; y <= y_max; y++) {
-        FUNC(draw_hline)(bmp, color, x1, x2, y);
+    rect_t r = rect_intersect((rect_t){min(x1, x2), min(y1, y2),
+                                       abs(x2 - x1) + 1, abs(y2 - y1) + 1},
+                              bmp->clip);
+    if (rect_is_empty(r) || color == get_mask_color()) {
+        return;
+    }
+    // Damage the whole rectangle at once, lines will be covered by it.
+    bitmap_add_damage(bmp, r.x, r.y, r.w, r.h);
+    for (int y = r.y; y < r.y + r.h; y++) {
+        FUNC(_fill_span)(bmp, color, r.x, y, r.w);
     }
 }
 
 
 void FUNC(fill_circle)(bitmap_t* bmp, pixel_t color, int x, int y, int r) {
-    int min_x = max(0, x - r);
-    int max_x = min(x + r, bmp->w - 1);
-    int min_y = max(0, y - r);
-    int max_y = min(y + r, bmp->h - 1);
+    rect_t c = rect_intersect((rect_t){x - r, y - r, 2 * r + 1, 2 * r + 1},
+                              bmp->clip);
+    if (rect_is_empty(c)) {
+        return;
+    }
+    int min_x = c.x;
+    int max_x = c.x + c.w - 1;
+    int min_y = c.y;
+    int max_y = c.y + c.h - 1;
+    bitmap_add_damage(bmp, c.x, c.y, c.w, c.h);
     for (int dy = min_y; dy <= max_y; dy++) {
         for (int dx = min_x; dx <= max_x; dx++) {
             if (_is_point_in_circle(x, y, r, dx, dy)) {
-                pixel_t* addr = bitmap_pixel_addr(bmp, dx, dy);
-                PRIMITIVE_PIXEL_FUNC(*addr, color);
+                FUNC(_plot)(bmp, dx, dy, color);
             }
         }
     }
@@ -82,24 +203,42 @@ void FUNC(fill_circle)(bitmap_t* bmp, pixel_t color, int x, int y, int r) {
 }
 
 
-static void FUNC(_draw_circle)(bitmap_t* bmp, pixel_t color, int xc, int yc,
-                               int x, int y)
+// Circle points are only tested against the clip rectangle when the
+// circle isn't inside it.
+static inline void FUNC(_plot_clipped)(bitmap_t* bmp, bool inside,
+                                       int x, int y, pixel_t color)
+{
+    if (inside || bitmap_is_clipped_in(bmp, x, y)) {
+        FUNC(_plot)(bmp, x, y, color);
+    }
+}
+
+
+static void FUNC(_draw_circle)(bitmap_t* bmp, bool inside, pixel_t color,
+                               int xc, int yc, int x, int y)
 {
-    PRIMITIVE_PIXEL_FUNC(*bitmap_pixel_addr(bmp, xc + x, yc + y), color);
-    PRIMITIVE_PIXEL_FUNC(*bitmap_pixel_addr(bmp, xc - x, yc - y), color);
-    PRIMITIVE_PIXEL_FUNC(*bitmap_pixel_addr(bmp, xc + x, yc + y), color);
-    PRIMITIVE_PIXEL_FUNC(*bitmap_pixel_addr(bmp, xc - x, yc - y), color);
-    PRIMITIVE_PIXEL_FUNC(*bitmap_pixel_addr(bmp, xc + y, yc + x), color);
-    PRIMITIVE_PIXEL_FUNC(*bitmap_pixel_addr(bmp, xc - y, yc - x), color);
-    PRIMITIVE_PIXEL_FUNC(*bitmap_pixel_addr(bmp, xc + y, yc + x), color);
-    PRIMITIVE_PIXEL_FUNC(*bitmap_pixel_addr(bmp, xc - y, yc - x), color);
+    FUNC(_plot_clipped)(bmp, inside, xc + x, yc + y, color);
+    FUNC(_plot_clipped)(bmp, inside, xc - x, yc - y, color);
+    FUNC(_plot_clipped)(bmp, inside, xc + x, yc + y, color);
+    FUNC(_plot_clipped)(bmp, inside, xc - x, yc - y, color);
+    FUNC(_plot_clipped)(bmp, inside, xc + y, yc + x, color);
+    FUNC(_plot_clipped)(bmp, inside, xc - y, yc - x, color);
+    FUNC(_plot_clipped)(bmp, inside, xc + y, yc + x, color);
+    FUNC(_plot_clipped)(bmp, inside, xc - y, yc - x, color);
 }
 
 
 void FUNC(draw_circle)(bitmap_t* bmp, pixel_t color, int xc, int yc, int r) {
+    rect_t box = {xc - r, yc - r, 2 * r + 1, 2 * r + 1};
+    rect_t c = rect_intersect(box, bmp->clip);
+    if (rect_is_empty(c)) {
+        return;
+    }
+    bool inside = rect_contains(bmp->clip, box);
     int x = 0, y = r;
     int d = 3 - 2 * r;
-    FUNC(_draw_circle)(bmp, color, xc, yc, x, y);
+    bitmap_add_damage(bmp, c.x, c.y, c.w, c.h);
+    FUNC(_draw_circle)(bmp, inside, color, xc, yc, x, y);
     while (y >= x) {
         x++;
         if (d > 0) {
@@ -108,30 +247,49 @@ void FUNC(draw_circle)(bitmap_t* bmp, pixel_t color, int xc, int yc, int r) {
         } else {
             d = d + 4 * x + 6;
         }
-        FUNC(_draw_circle)(bmp, color, xc, yc, x, y);
+        FUNC(_draw_circle)(bmp, inside, color, xc, yc, x, y);
     }
 }
 
 
 // Dashed functions ---------------------------------------------------
+// Dashed lines are clipped and damaged once, then drawn a dash at a
+// time: runs of pixels of the same color along the line, and across it
+// for the stroke.
 void FUNC(draw_dashed_hline)(bitmap_t* bmp, pixel_t color_a, pixel_t color_b,
                              int x1, int x2, int y,
                              int dash_start, int dash_length, int direction,
                              int stroke)
 {
-    if (y < 0 || y >= bmp->h) {
+    // Dashes start from the ends of the line, wherever it's clipped.
+    rect_t c = bmp->clip;
+    int x_min = max(min(x1, x2), c.x);
+    int x_max = min(max(x1, x2), c.x + c.w - 1);
+    int y_min = max(y - stroke / 2, c.y);
+    int y_max = min(y + stroke / 2, c.y + c.h - 1);
+    if (x_min > x_max || y_min > y_max) {
         return;
     }
-    int x_min = max(min(x1, x2), 0);
-    int x_max = min(max(x1, x2), bmp->w - 1);
-    int length = (x_max - x_min) + dash_start;
-    pixel_t* addr = bitmap_pixel_addr(bmp, x_min, y);
-    for (int x = x_min; x <= x_max; x++) {
-        pixel_t color = (length % (2 * dash_length) < dash_length)
-                      ? color_a : color_b;
-        FUNC(draw_vline)(bmp, color, x, y - stroke / 2, y + stroke / 2);
-        addr++;
-        length += direction;
+    bitmap_add_damage(bmp, x_min, y_min, x_max - x_min + 1,
+                      y_max - y_min + 1);
+    int length = abs(x2 - x1) + dash_start
+               + (x_min - min(x1, x2)) * direction;
+    for (int x = x_min; x <= x_max;) {
+        bool first = _is_first_dash(length, dash_length);
+        int n = 1;
+        while (x + n <= x_max
+            && _is_first_dash(length + n * direction, dash_length) == first)
+        {
+            n++;
+        }
+        pixel_t color = first ? color_a : color_b;
+        for (int dy = y_min; color != get_mask_color() && dy <= y_max;
+             dy++)
+        {
+            FUNC(_fill_span)(bmp, color, x, dy, n);
+        }
+        x += n;
+        length += n * direction;
     }
 }
 
@@ -141,16 +299,33 @@ void FUNC(draw_dashed_vline)(bitmap_t* bmp, pixel_t color_a, pixel_t color_b,
                              int dash_start, int dash_length, int direction,
                              int stroke)
 {
-    int y_min = max(min(y1, y2), 0);
-    int y_max = min(max(y1, y2), bmp->h - 1);
-    int length = (y2 - y1) + dash_start;
-    pixel_t* addr = bitmap_pixel_addr(bmp, x, y_min);
-    for (int y = y_min; y <= y_max; y++) {
-        pixel_t color = (length % (2 * dash_length) < dash_length)
-                      ? color_a : color_b;
-        FUNC(draw_hline)(bmp, color, x - stroke / 2, x + stroke / 2, y);
-        addr += bmp->w;
-        length += direction;
+    rect_t c = bmp->clip;
+    int y_min = max(min(y1, y2), c.y);
+    int y_max = min(max(y1, y2), c.y + c.h - 1);
+    int x_min = max(x - stroke / 2, c.x);
+    int x_max = min(x + stroke / 2, c.x + c.w - 1);
+    if (x_min > x_max || y_min > y_max) {
+        return;
+    }
+    bitmap_add_damage(bmp, x_min, y_min, x_max - x_min + 1,
+                      y_max - y_min + 1);
+    int length = (y2 - y1) + dash_start + (y_min - min(y1, y2)) * direction;
+    for (int y = y_min; y <= y_max;) {
+        bool first = _is_first_dash(length, dash_length);
+        int n = 1;
+        while (y + n <= y_max
+            && _is_first_dash(length + n * direction, dash_length) == first)
+        {
+            n++;
+        }
+        pixel_t color = first ? color_a : color_b;
+        for (int dx = x_min; color != get_mask_color() && dx <= x_max;
+             dx++)
+        {
+            FUNC(_fill_column)(bmp, color, dx, y, n);
+        }
+        y += n;
+        length += n * direction;
     }
 }
 
@@ -184,6 +359,8 @@ void FUNC(draw_dashed_rect)(bitmap_t* bmp, pixel_t color_a, pixel_t color_b,
 
 #undef PRIMITIVE_FUNC_SUFFIX
 #undef PRIMITIVE_PIXEL_FUNC
+#undef PRIMITIVE_FILL_FUNC
+#undef PRIMITIVE_SET
 #undef __TCONCAT
 #undef _TCONCAT
 #undef FUNC
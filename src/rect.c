@@ -0,0 +1,184 @@
+#include "jcfb/rect.h"
+#include "jcfb/util.h"
+
+
+// Extra area, in pixels, two rectangles can cover once merged. Copying
+// a few more pixels is cheaper than handling many small rectangles.
+#define MERGE_SLACK     1024
+
+
+static long _area(rect_t r) {
+    return (long)r.w * r.h;
+}
+
+
+bool rect_is_empty(rect_t r) {
+    return r.w <= 0 || r.h <= 0;
+}
+
+
+bool rect_contains(rect_t in, rect_t r) {
+    return r.x >= in.x && r.y >= in.y
+        && r.x + r.w <= in.x + in.w
+        && r.y + r.h <= in.y + in.h;
+}
+
+
+rect_t rect_intersect(rect_t a, rect_t b) {
+    int x1 = max(a.x, b.x);
+    int y1 = max(a.y, b.y);
+    int x2 = min(a.x + a.w, b.x + b.w);
+    int y2 = min(a.y + a.h, b.y + b.h);
+    return (rect_t){x1, y1, max(0, x2 - x1), max(0, y2 - y1)};
+}
+
+
+rect_t rect_union(rect_t a, rect_t b) {
+    if (rect_is_empty(a)) {
+        return b;
+    }
+    if (rect_is_empty(b)) {
+        return a;
+    }
+    int x1 = min(a.x, b.x);
+    int y1 = min(a.y, b.y);
+    int x2 = max(a.x + a.w, b.x + b.w);
+    int y2 = max(a.y + a.h, b.y + b.h);
+    return (rect_t){x1, y1, x2 - x1, y2 - y1};
+}
+
+
+void rect_list_add(rect_list_t* list, rect_t r) {
+    if (rect_is_empty(r)) {
+        return;
+    }
+    // Most additions come in drawing order, so start from the last
+    // rectangle.
+    for (int i = list->count - 1; i >= 0; i--) {
+        if (rect_contains(list->rects[i], r)) {
+            return;
+        }
+    }
+    if (list->count == RECT_LIST_MAX) {
+        rect_list_merge(list);
+    }
+    if (list->count < RECT_LIST_MAX) {
+        list->rects[list->count++] = r;
+        return;
+    }
+
+    int best = 0;
+    long best_growth = -1;
+    for (int i = 0; i < list->count; i++) {
+        long growth = _area(rect_union(list->rects[i], r))
+                    - _area(list->rects[i]);
+        if (best_growth < 0 || growth < best_growth) {
+            best = i;
+            best_growth = growth;
+        }
+    }
+    list->rects[best] = rect_union(list->rects[best], r);
+}
+
+
+void rect_list_merge(rect_list_t* list) {
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (int i = 0; i < list->count; i++) {
+            for (int j = i + 1; j < list->count; j++) {
+                rect_t* a = &list->rects[i];
+                rect_t* b = &list->rects[j];
+                rect_t u = rect_union(*a, *b);
+                if (_area(u) > _area(*a) + _area(*b) + MERGE_SLACK) {
+                    continue;
+                }
+                *a = u;
+                *b = list->rects[--list->count];
+                merged = true;
+                j = i;
+            }
+        }
+    }
+}
+
+
+#ifdef TEST
+#include <assert.h>
+#include <stdlib.h>
+
+
+static bool _list_covers(const rect_list_t* list, int x, int y) {
+    for (int i = 0; i < list->count; i++) {
+        if (rect_contains(list->rects[i], (rect_t){x, y, 1, 1})) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+int main(void) {
+    // TEST rect_intersect, rect_union, rect_contains
+    rect_t a = {0, 0, 10, 10}, b = {5, 5, 10, 10}, c = {20, 0, 5, 5};
+    rect_t r = rect_intersect(a, b);
+    assert(r.x == 5 && r.y == 5 && r.w == 5 && r.h == 5);
+    assert(rect_is_empty(rect_intersect(a, c)));
+    r = rect_union(a, b);
+    assert(r.x == 0 && r.y == 0 && r.w == 15 && r.h == 15);
+    r = rect_union((rect_t){3, 3, 0, 2}, c);
+    assert(r.x == c.x && r.y == c.y && r.w == c.w && r.h == c.h);
+    assert(rect_contains(a, (rect_t){2, 2, 8, 8}));
+    assert(!rect_contains(a, b));
+
+    // TEST rect_list_add, ignores empty and covered rectangles
+    rect_list_t list = {0};
+    rect_list_add(&list, (rect_t){1, 1, 0, 5});
+    assert(list.count == 0);
+    rect_list_add(&list, a);
+    rect_list_add(&list, (rect_t){2, 2, 3, 3});
+    assert(list.count == 1);
+    rect_list_add(&list, c);
+    assert(list.count == 2);
+
+    // TEST rect_list_merge, merges close rectangles, not far ones
+    list = (rect_list_t){0};
+    rect_list_add(&list, (rect_t){0, 0, 10, 10});
+    rect_list_add(&list, (rect_t){10, 0, 10, 10});
+    rect_list_add(&list, (rect_t){500, 500, 10, 10});
+    rect_list_merge(&list);
+    assert(list.count == 2);
+    assert(_list_covers(&list, 19, 9) && _list_covers(&list, 505, 505));
+    assert(!_list_covers(&list, 200, 200));
+
+    // TEST rect_list_add, keeps covering every rectangle added once full
+    srand(3);
+    list = (rect_list_t){0};
+    static bool added[256][256];
+    for (int i = 0; i < 500; i++) {
+        rect_t s = {rand() % 240, rand() % 240, rand() % 16, rand() % 16};
+        rect_list_add(&list, s);
+        assert(list.count <= RECT_LIST_MAX);
+        for (int y = s.y; y < s.y + s.h; y++) {
+            for (int x = s.x; x < s.x + s.w; x++) {
+                added[y][x] = true;
+            }
+        }
+    }
+    for (int y = 0; y < 256; y++) {
+        for (int x = 0; x < 256; x++) {
+            assert(!added[y][x] || _list_covers(&list, x, y));
+        }
+    }
+    rect_list_merge(&list);
+    for (int y = 0; y < 256; y++) {
+        for (int x = 0; x < 256; x++) {
+            assert(!added[y][x] || _list_covers(&list, x, y));
+        }
+    }
+
+    return 0;
+}
+
+
+#endif
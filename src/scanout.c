@@ -0,0 +1,525 @@
+/*
+ * JCFB scanout kernels
+ *
+ * The 24 and 16 bits kernels rely on the framebuffer being little
+ * endian, like the per-pixel copy they replace: the framebuffer pixel
+ * is made of the low bytes of the 32 bits bitmap pixel.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+#include "jcfb/scanout.h"
+#include "jcfb/simd.h"
+
+
+// Row packers --------------------------------------------------------
+typedef void (*_row_func_t)(uint8_t* dst, const pixel_t* src, int n);
+typedef void (*_scanout_func_t)(const scanout_t* so, void* dst,
+                                const bitmap_t* src,
+                                int x, int y, int w, int h);
+
+
+static void _pack24_row(uint8_t* dst, const pixel_t* src, int n) {
+    int i = 0;
+    // Four pixels fit exactly in 12 bytes.
+    for (; i + 4 <= n; i += 4) {
+        uint64_t lo = (uint64_t)(src[i + 0] & 0xffffff)
+                    | (uint64_t)(src[i + 1] & 0xffffff) << 24
+                    | (uint64_t)(src[i + 2] & 0xffff) << 48;
+        uint32_t hi = ((src[i + 2] >> 16) & 0xff)
+                    | (src[i + 3] << 8);
+        memcpy(dst + i * 3, &lo, sizeof(lo));
+        memcpy(dst + i * 3 + 8, &hi, sizeof(hi));
+    }
+    for (; i < n; i++) {
+        memcpy(dst + i * 3, src + i, 3);
+    }
+}
+
+
+static void _pack16_row(uint8_t* dst, const pixel_t* src, int n) {
+    for (int i = 0; i < n; i++) {
+        uint16_t p = src[i];
+        memcpy(dst + i * 2, &p, sizeof(p));
+    }
+}
+
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("ssse3")))
+static void _pack24_row_ssse3(uint8_t* dst, const pixel_t* src, int n) {
+    // Drop the fourth byte of every pixel: 16 bytes in, 12 bytes out.
+    const __m128i shuf = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10,
+                                       12, 13, 14, -1, -1, -1, -1);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i* s = (const __m128i*)(src + i);
+        __m128i p0 = _mm_shuffle_epi8(_mm_loadu_si128(s + 0), shuf);
+        __m128i p1 = _mm_shuffle_epi8(_mm_loadu_si128(s + 1), shuf);
+        __m128i p2 = _mm_shuffle_epi8(_mm_loadu_si128(s + 2), shuf);
+        __m128i p3 = _mm_shuffle_epi8(_mm_loadu_si128(s + 3), shuf);
+        __m128i* d = (__m128i*)(dst + i * 3);
+        _mm_storeu_si128(d + 0,
+            _mm_or_si128(p0, _mm_slli_si128(p1, 12)));
+        _mm_storeu_si128(d + 1,
+            _mm_or_si128(_mm_srli_si128(p1, 4), _mm_slli_si128(p2, 8)));
+        _mm_storeu_si128(d + 2,
+            _mm_or_si128(_mm_srli_si128(p2, 8), _mm_slli_si128(p3, 4)));
+    }
+    _pack24_row(dst + i * 3, src + i, n - i);
+}
+#endif
+
+
+#if defined(__SSE2__)
+static void _pack16_row_sse2(uint8_t* dst, const pixel_t* src, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i* s = (const __m128i*)(src + i);
+        // Sign-extend the low 16 bits so that the signed saturating
+        // pack keeps them untouched.
+        __m128i a = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128(s), 16),
+                                   16);
+        __m128i b = _mm_srai_epi32(
+            _mm_slli_epi32(_mm_loadu_si128(s + 1), 16), 16
+        );
+        _mm_storeu_si128((__m128i*)(dst + i * 2), _mm_packs_epi32(a, b));
+    }
+    _pack16_row(dst + i * 2, src + i, n - i);
+}
+#endif
+
+
+#if defined(__ARM_NEON)
+static void _pack24_row_neon(uint8_t* dst, const pixel_t* src, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16x4_t p = vld4q_u8((const uint8_t*)(src + i));
+        uint8x16x3_t o = {{p.val[0], p.val[1], p.val[2]}};
+        vst3q_u8(dst + i * 3, o);
+    }
+    _pack24_row(dst + i * 3, src + i, n - i);
+}
+
+
+static void _pack16_row_neon(uint8_t* dst, const pixel_t* src, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t p = vcombine_u16(vmovn_u32(vld1q_u32(src + i)),
+                                    vmovn_u32(vld1q_u32(src + i + 4)));
+        vst1q_u16((uint16_t*)(dst + i * 2), p);
+    }
+    _pack16_row(dst + i * 2, src + i, n - i);
+}
+#endif
+
+
+static inline void _scanout_rows(const scanout_t* so, void* dst,
+                                 const bitmap_t* src,
+                                 int x, int y, int w, int h,
+                                 _row_func_t row_func)
+{
+    uint8_t* d = (uint8_t*)dst + y * so->line_length + x * so->bpp;
+    const pixel_t* s = src->mem + y * src->stride + x;
+    for (int j = 0; j < h; j++) {
+        row_func(d, s, w);
+        d += so->line_length;
+        s += src->stride;
+    }
+}
+
+
+// Kernels ------------------------------------------------------------
+static void _scanout_generic(const scanout_t* so, void* dst,
+                             const bitmap_t* src,
+                             int x, int y, int w, int h)
+{
+    for (int j = y; j < y + h; j++) {
+        uint8_t* d = (uint8_t*)dst + j * so->line_length + x * so->bpp;
+        const pixel_t* s = src->mem + j * src->stride + x;
+        for (int i = 0; i < w; i++) {
+            memcpy(d + i * so->bpp, s + i, so->bpp);
+        }
+    }
+}
+
+
+static void _scanout_rows32(const scanout_t* so, void* dst,
+                            const bitmap_t* src,
+                            int x, int y, int w, int h)
+{
+    uint8_t* d = (uint8_t*)dst + y * so->line_length + x * sizeof(pixel_t);
+    const pixel_t* s = src->mem + y * src->stride + x;
+    for (int j = 0; j < h; j++) {
+        memcpy(d, s, w * sizeof(pixel_t));
+        d += so->line_length;
+        s += src->stride;
+    }
+}
+
+
+static void _scanout_bulk32(const scanout_t* so, void* dst,
+                            const bitmap_t* src,
+                            int x, int y, int w, int h)
+{
+    // Lines are contiguous on both sides only for full-width copies of
+    // bitmaps as wide as the screen.
+    if (x != 0 || w != src->w || src->stride != src->w
+     || (size_t)w * sizeof(pixel_t) != so->line_length)
+    {
+        _scanout_rows32(so, dst, src, x, y, w, h);
+        return;
+    }
+    memcpy((uint8_t*)dst + y * so->line_length, src->mem + y * src->stride,
+           h * so->line_length);
+}
+
+
+#define SCANOUT_PACK_KERNEL(_name, _row_func) \
+    static void _name(const scanout_t* so, void* dst, \
+                      const bitmap_t* src, int x, int y, int w, int h) \
+    { \
+        _scanout_rows(so, dst, src, x, y, w, h, _row_func); \
+    }
+
+SCANOUT_PACK_KERNEL(_scanout_pack24, _pack24_row)
+SCANOUT_PACK_KERNEL(_scanout_pack16, _pack16_row)
+#if defined(__x86_64__) || defined(__i386__)
+SCANOUT_PACK_KERNEL(_scanout_pack24_ssse3, _pack24_row_ssse3)
+#endif
+#if defined(__SSE2__)
+SCANOUT_PACK_KERNEL(_scanout_pack16_sse2, _pack16_row_sse2)
+#endif
+#if defined(__ARM_NEON)
+SCANOUT_PACK_KERNEL(_scanout_pack24_neon, _pack24_row_neon)
+SCANOUT_PACK_KERNEL(_scanout_pack16_neon, _pack16_row_neon)
+#endif
+
+#undef SCANOUT_PACK_KERNEL
+
+
+// Packed sources, whose pixels are already at the framebuffer depth or
+// need to be loaded one by one.
+static void _scanout_packed_rows(const scanout_t* so, void* dst,
+                                 const bitmap_t* src,
+                                 int x, int y, int w, int h)
+{
+    uint8_t* d = (uint8_t*)dst + y * so->line_length + x * so->bpp;
+    for (int j = y; j < y + h; j++) {
+        memcpy(d, bitmap_addr(src, x, j), w * so->bpp);
+        d += so->line_length;
+    }
+}
+
+
+static void _scanout_packed_generic(const scanout_t* so, void* dst,
+                                    const bitmap_t* src,
+                                    int x, int y, int w, int h)
+{
+    for (int j = y; j < y + h; j++) {
+        uint8_t* d = (uint8_t*)dst + j * so->line_length + x * so->bpp;
+        const uint8_t* s = bitmap_addr(src, x, j);
+        for (int i = 0; i < w; i++) {
+            pixel_t p = pixel_load(s + i * src->psize, src->psize);
+            memcpy(d + i * so->bpp, &p, so->bpp);
+        }
+    }
+}
+
+
+// Kernel copying `src`, whose storage may not be the 4 bytes the
+// selected kernel expects.
+static _scanout_func_t _kernel(const scanout_t* so, const bitmap_t* src) {
+    if (src->psize == sizeof(pixel_t)) {
+        return so->func;
+    }
+    if (src->psize == so->bpp) {
+        return _scanout_packed_rows;
+    }
+    return _scanout_packed_generic;
+}
+
+
+// Selection ----------------------------------------------------------
+static bool _supports(scanout_id_t id, size_t bpp, size_t line_length,
+                      int w)
+{
+    switch (id) {
+      case SCANOUT_GENERIC:
+        return bpp >= 1 && bpp <= sizeof(pixel_t);
+      case SCANOUT_BULK32:
+        return bpp == 4 && line_length == w * bpp;
+      case SCANOUT_ROWS32:
+        return bpp == 4;
+      case SCANOUT_PACK24:
+        return bpp == 3;
+      case SCANOUT_PACK16:
+        return bpp == 2;
+      default:
+        return false;
+    }
+}
+
+
+int scanout_init_ex(scanout_t* so, scanout_id_t id,
+                    size_t bits_per_pixel, size_t line_length, int w)
+{
+    size_t bpp = bits_per_pixel / 8;
+    if (bits_per_pixel % 8 || !_supports(id, bpp, line_length, w)) {
+        return -1;
+    }
+    *so = (scanout_t){
+        .id = id,
+        .bpp = bpp,
+        .line_length = line_length,
+        .func = _scanout_generic,
+    };
+    switch (id) {
+      case SCANOUT_BULK32:
+        so->func = _scanout_bulk32;
+        break;
+
+      case SCANOUT_ROWS32:
+        so->func = _scanout_rows32;
+        break;
+
+      case SCANOUT_PACK24:
+        so->func = _scanout_pack24;
+#if defined(__ARM_NEON)
+        if (simd_has(SIMD_NEON)) {
+            so->func = _scanout_pack24_neon;
+        }
+#elif defined(__x86_64__) || defined(__i386__)
+        if (simd_has(SIMD_SSSE3)) {
+            so->func = _scanout_pack24_ssse3;
+        }
+#endif
+        break;
+
+      case SCANOUT_PACK16:
+        so->func = _scanout_pack16;
+#if defined(__ARM_NEON)
+        if (simd_has(SIMD_NEON)) {
+            so->func = _scanout_pack16_neon;
+        }
+#elif defined(__SSE2__)
+        if (simd_has(SIMD_SSE2)) {
+            so->func = _scanout_pack16_sse2;
+        }
+#endif
+        break;
+
+      default:
+        break;
+    }
+    return 0;
+}
+
+
+int scanout_init(scanout_t* so, size_t bits_per_pixel, size_t line_length,
+                 int w)
+{
+    // Ordered from the fastest to the slowest kernel.
+    static const scanout_id_t ids[] = {
+        SCANOUT_BULK32,
+        SCANOUT_ROWS32,
+        SCANOUT_PACK24,
+        SCANOUT_PACK16,
+        SCANOUT_GENERIC,
+    };
+    for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+        if (scanout_init_ex(so, ids[i], bits_per_pixel, line_length,
+                            w) == 0) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+
+void scanout_copy(const scanout_t* so, void* dst, const bitmap_t* src,
+                  int x, int y, int w, int h)
+{
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+    _kernel(so, src)(so, dst, src, x, y, w, h);
+}
+
+
+// Bands under this height aren't worth waking the workers for.
+#define MIN_BAND_ROWS 32
+
+
+typedef struct {
+    const scanout_t* so;
+    void* dst;
+    const bitmap_t* src;
+    int x, y, w, h;
+    int band_h;
+} _band_job_t;
+
+
+static void _band_func(void* arg, int job) {
+    const _band_job_t* b = arg;
+    int y = b->y + job * b->band_h;
+    int h = b->band_h;
+    if (y + h > b->y + b->h) {
+        h = b->y + b->h - y;
+    }
+    _kernel(b->so, b->src)(b->so, b->dst, b->src, b->x, y, b->w, h);
+}
+
+
+void scanout_copy_pool(const scanout_t* so, pool_t* pool, void* dst,
+                       const bitmap_t* src, int x, int y, int w, int h)
+{
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+    int nbands = pool->nthreads;
+    if (nbands > h / MIN_BAND_ROWS) {
+        nbands = h / MIN_BAND_ROWS;
+    }
+    if (nbands <= 1) {
+        scanout_copy(so, dst, src, x, y, w, h);
+        return;
+    }
+    _band_job_t b = {
+        .so = so, .dst = dst, .src = src,
+        .x = x, .y = y, .w = w, .h = h,
+        .band_h = (h + nbands - 1) / nbands,
+    };
+    pool_run(pool, _band_func, &b, (h + b.band_h - 1) / b.band_h);
+}
+
+
+const char* scanout_name(scanout_id_t id) {
+    static const char* names[SCANOUT_MAX] = {
+        [SCANOUT_GENERIC] = "generic",
+        [SCANOUT_BULK32] = "bulk32",
+        [SCANOUT_ROWS32] = "rows32",
+        [SCANOUT_PACK24] = "pack24",
+        [SCANOUT_PACK16] = "pack16",
+    };
+    if (id < 0 || id >= SCANOUT_MAX) {
+        return "unknown";
+    }
+    return names[id];
+}
+
+
+#ifdef TEST
+#include <assert.h>
+#include <stdlib.h>
+
+
+static void _fill_random(bitmap_t* bmp) {
+    uint8_t* mem = (uint8_t*)bmp->mem;
+    for (size_t i = 0; i < bitmap_memsize(bmp); i++) {
+        mem[i] = rand();
+    }
+}
+
+
+// Copy `src` whole, then an inner rectangle of it, with every kernel
+// able to write `bpp` bytes pixels on lines of `line_length` bytes, and
+// compare their output, padding included, with the generic kernel's.
+static void _test_kernels(const bitmap_t* src, size_t bpp,
+                          size_t line_length, int screen_w, int screen_h)
+{
+    size_t size = line_length * screen_h;
+    uint8_t* expected = malloc(size);
+    uint8_t* out = malloc(size);
+    assert(expected && out);
+    int w = src->w < screen_w ? src->w : screen_w;
+    int h = src->h < screen_h ? src->h : screen_h;
+    int rects[][4] = {{0, 0, w, h}, {1, 2, w - 3, h - 3}};
+    for (int r = 0; r < 2; r++) {
+        int* rect = rects[r];
+        scanout_t so;
+        assert(scanout_init_ex(&so, SCANOUT_GENERIC, bpp * 8, line_length,
+                               screen_w) == 0);
+        memset(expected, 0x5a, size);
+        scanout_copy(&so, expected, src, rect[0], rect[1], rect[2],
+                     rect[3]);
+        for (int id = 0; id < SCANOUT_MAX; id++) {
+            if (scanout_init_ex(&so, id, bpp * 8, line_length,
+                                screen_w) < 0) {
+                continue;
+            }
+            memset(out, 0x5a, size);
+            scanout_copy(&so, out, src, rect[0], rect[1], rect[2],
+                         rect[3]);
+            assert(!memcmp(out, expected, size));
+        }
+    }
+    free(expected);
+    free(out);
+}
+
+
+int main(void) {
+    // TEST scanout_init, picks a kernel for every depth
+    scanout_t so;
+    assert(scanout_init(&so, 32, 64 * 4, 64) == 0);
+    assert(so.id == SCANOUT_BULK32);
+    assert(scanout_init(&so, 32, 64 * 4 + 12, 64) == 0);
+    assert(so.id == SCANOUT_ROWS32);
+    assert(scanout_init(&so, 24, 64 * 3, 64) == 0);
+    assert(so.id == SCANOUT_PACK24);
+    assert(scanout_init(&so, 16, 64 * 2, 64) == 0);
+    assert(so.id == SCANOUT_PACK16);
+    assert(scanout_init(&so, 12, 64 * 2, 64) < 0);
+
+    // TEST kernels against the generic copy: bitmaps as wide as the
+    // screen, narrower ones, views with a stride and packed bitmaps, on
+    // unpadded and padded lines, with widths leaving vector tails
+    for (size_t bpp = 2; bpp <= 4; bpp++) {
+        for (int screen_w = 7; screen_w <= 71; screen_w += 32) {
+            for (size_t pad = 0; pad <= 12; pad += 12) {
+                size_t line_length = screen_w * bpp + pad;
+                int screen_h = 9;
+                bitmap_t full, narrow, parent, view, packed16, packed24;
+                bitmap_init(&full, screen_w, screen_h);
+                bitmap_init(&narrow, screen_w - 3, screen_h - 1);
+                bitmap_init(&parent, screen_w + 5, screen_h + 2);
+                bitmap_view(&view, &parent, 3, 1, screen_w, screen_h);
+                bitmap_init_packed(&packed16, PIXFMT_RGB16, screen_w,
+                                   screen_h);
+                bitmap_init_packed(&packed24, PIXFMT_RGB24, screen_w,
+                                   screen_h);
+                _fill_random(&full);
+                _fill_random(&narrow);
+                _fill_random(&parent);
+                _fill_random(&packed16);
+                _fill_random(&packed24);
+                const bitmap_t* srcs[] = {
+                    &full, &narrow, &view, &packed16, &packed24,
+                };
+                for (int i = 0; i < 5; i++) {
+                    _test_kernels(srcs[i], bpp, line_length, screen_w,
+                                  screen_h);
+                }
+                bitmap_wipe(&full);
+                bitmap_wipe(&narrow);
+                bitmap_wipe(&parent);
+                bitmap_wipe(&packed16);
+                bitmap_wipe(&packed24);
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+#endif
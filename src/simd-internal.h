@@ -0,0 +1,34 @@
+/*
+ * SIMD module internals
+ *
+ * Hooks between the SIMD module and the modules providing kernels, and
+ * helpers they share, which aren't part of the public API.
+ */
+#ifndef _jcfb_simd_internal_h_
+#define _jcfb_simd_internal_h_
+
+
+#include "jcfb/simd.h"
+
+
+/*
+ * Interpolate the 8 bits components of `a` and `b`, `b` weighing
+ * `t / 256`, two at once in 16 bits fields. Kernels give the same
+ * results.
+ */
+static inline pixel_t simd_lerp(pixel_t a, pixel_t b, uint32_t t) {
+    uint32_t lo = (a & 0x00ff00ff) * (256 - t) + (b & 0x00ff00ff) * t;
+    uint32_t hi = (a >> 8 & 0x00ff00ff) * (256 - t)
+                + (b >> 8 & 0x00ff00ff) * t;
+    return (lo >> 8 & 0x00ff00ff) | (hi & 0xff00ff00);
+}
+
+
+/*
+ * Fill the conversion, blending and compositing kernels of `table` for
+ * its level, which are provided by the pixel module.
+ */
+void pixel_fill_kernels(simd_kernels_t* table);
+
+
+#endif
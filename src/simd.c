@@ -0,0 +1,613 @@
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "jcfb/simd.h"
+
+#include "simd-internal.h"
+
+
+// Scalar kernels -----------------------------------------------------
+static void _clear_scalar(pixel_t* dst, pixel_t color, int n) {
+    for (int i = 0; i < n; i++) {
+        dst[i] = color;
+    }
+}
+
+
+// libc's copies are already vectorized for the running CPU.
+static void _copy(pixel_t* dst, const pixel_t* src, int n) {
+    memcpy(dst, src, n * sizeof(pixel_t));
+}
+
+
+static void _mask_scalar(pixel_t* dst, const pixel_t* src, pixel_t mask,
+                         int n)
+{
+    for (int i = 0; i < n; i++) {
+        if (src[i] != mask) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+
+static void _scale_scalar(pixel_t* dst, const pixel_t* src, const int* cols,
+                          int n)
+{
+    for (int i = 0; i < n; i++) {
+        dst[i] = src[cols[i]];
+    }
+}
+
+
+static void _lerp_scalar(pixel_t* dst, const pixel_t* a, const pixel_t* b,
+                         int t, int n)
+{
+    for (int i = 0; i < n; i++) {
+        dst[i] = simd_lerp(a[i], b[i], t);
+    }
+}
+
+
+static void _scale_lerp_scalar(pixel_t* dst, const pixel_t* src,
+                               const int* cols, const uint8_t* w,
+                               const void* map, int n)
+{
+    for (int i = 0; i < n; i++) {
+        dst[i] = simd_lerp(src[cols[i]], src[cols[i] + 1], w[i]);
+    }
+}
+
+
+// Bytes averages rounded up, like the vector ones.
+static inline pixel_t _avg(pixel_t x, pixel_t y) {
+    return (x | y) - ((x ^ y) >> 1 & 0x7f7f7f7f);
+}
+
+
+static void _box_scalar(pixel_t* dst, const pixel_t* a, const pixel_t* b,
+                        int n)
+{
+    for (int i = 0; i < n; i++) {
+        dst[i] = _avg(_avg(a[2 * i], b[2 * i]),
+                      _avg(a[2 * i + 1], b[2 * i + 1]));
+    }
+}
+
+
+// x86 kernels --------------------------------------------------------
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static void _clear_sse2(pixel_t* dst, pixel_t color, int n) {
+    __m128i c = _mm_set1_epi32(color);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_si128((__m128i*)(dst + i), c);
+    }
+    _clear_scalar(dst + i, color, n - i);
+}
+
+
+// Masked pixels keep the destination: d = (eq & d) | (~eq & s).
+__attribute__((target("sse2")))
+static void _mask_sse2(pixel_t* dst, const pixel_t* src, pixel_t mask,
+                       int n)
+{
+    __m128i m = _mm_set1_epi32(mask);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i eq = _mm_cmpeq_epi32(s, m);
+        d = _mm_or_si128(_mm_and_si128(eq, d), _mm_andnot_si128(eq, s));
+        _mm_storeu_si128((__m128i*)(dst + i), d);
+    }
+    _mask_scalar(dst + i, src + i, mask, n - i);
+}
+
+
+// Even and odd bytes are interpolated in 16 bits fields, without
+// shuffles: x + (y - x) * t / 256 is the high half of (y - x) * 2 by
+// t * 128, which `t` holds in both fields of each pixel (rounded down
+// like the scalar kernels).
+__attribute__((target("sse2")))
+static inline __m128i _lerp_sse2_4(__m128i a, __m128i b, __m128i t) {
+    __m128i even = _mm_set1_epi16(0xff);
+    __m128i ae = _mm_and_si128(a, even);
+    __m128i ao = _mm_srli_epi16(a, 8);
+    __m128i de = _mm_sub_epi16(_mm_and_si128(b, even), ae);
+    __m128i dod = _mm_sub_epi16(_mm_srli_epi16(b, 8), ao);
+    ae = _mm_add_epi16(ae, _mm_mulhi_epi16(_mm_slli_epi16(de, 1), t));
+    ao = _mm_add_epi16(ao, _mm_mulhi_epi16(_mm_slli_epi16(dod, 1), t));
+    return _mm_or_si128(ae, _mm_slli_epi16(ao, 8));
+}
+
+
+__attribute__((target("sse2")))
+static void _lerp_sse2(pixel_t* dst, const pixel_t* a, const pixel_t* b,
+                       int t, int n)
+{
+    __m128i vt = _mm_set1_epi16(t << 7);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _lerp_sse2_4(va, vb, vt));
+    }
+    _lerp_scalar(dst + i, a + i, b + i, t, n - i);
+}
+
+
+// Pixels are loaded with the next one, then split.
+__attribute__((target("sse2")))
+static void _scale_lerp_sse2(pixel_t* dst, const pixel_t* src,
+                             const int* cols, const uint8_t* w,
+                             const void* map, int n)
+{
+    __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const int* c = cols + i;
+        __m128 p01 = _mm_castsi128_ps(_mm_unpacklo_epi64(
+            _mm_loadl_epi64((const __m128i*)(src + c[0])),
+            _mm_loadl_epi64((const __m128i*)(src + c[1]))));
+        __m128 p23 = _mm_castsi128_ps(_mm_unpacklo_epi64(
+            _mm_loadl_epi64((const __m128i*)(src + c[2])),
+            _mm_loadl_epi64((const __m128i*)(src + c[3]))));
+        __m128i a = _mm_castps_si128(
+            _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i b = _mm_castps_si128(
+            _mm_shuffle_ps(p01, p23, _MM_SHUFFLE(3, 1, 3, 1)));
+        uint32_t w4;
+        memcpy(&w4, w + i, sizeof(w4));
+        __m128i t = _mm_unpacklo_epi8(_mm_cvtsi32_si128(w4), zero);
+        t = _mm_slli_epi16(_mm_unpacklo_epi16(t, t), 7);
+        _mm_storeu_si128((__m128i*)(dst + i), _lerp_sse2_4(a, b, t));
+    }
+    _scale_lerp_scalar(dst + i, src, cols + i, w + i, NULL, n - i);
+}
+
+
+// Rows are averaged, then even and odd pixels.
+__attribute__((target("sse2")))
+static void _box_sse2(pixel_t* dst, const pixel_t* a, const pixel_t* b,
+                      int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v0 = _mm_avg_epu8(
+            _mm_loadu_si128((const __m128i*)(a + 2 * i)),
+            _mm_loadu_si128((const __m128i*)(b + 2 * i)));
+        __m128i v1 = _mm_avg_epu8(
+            _mm_loadu_si128((const __m128i*)(a + 2 * i + 4)),
+            _mm_loadu_si128((const __m128i*)(b + 2 * i + 4)));
+        __m128 f0 = _mm_castsi128_ps(v0);
+        __m128 f1 = _mm_castsi128_ps(v1);
+        __m128i even = _mm_castps_si128(
+            _mm_shuffle_ps(f0, f1, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i odd = _mm_castps_si128(
+            _mm_shuffle_ps(f0, f1, _MM_SHUFFLE(3, 1, 3, 1)));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_avg_epu8(even, odd));
+    }
+    _box_scalar(dst + i, a + 2 * i, b + 2 * i, n - i);
+}
+
+
+__attribute__((target("avx2")))
+static void _clear_avx2(pixel_t* dst, pixel_t color, int n) {
+    __m256i c = _mm256_set1_epi32(color);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_si256((__m256i*)(dst + i), c);
+    }
+    _clear_scalar(dst + i, color, n - i);
+}
+
+
+__attribute__((target("avx2")))
+static void _mask_avx2(pixel_t* dst, const pixel_t* src, pixel_t mask,
+                       int n)
+{
+    __m256i m = _mm256_set1_epi32(mask);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        __m256i eq = _mm256_cmpeq_epi32(s, m);
+        _mm256_storeu_si256((__m256i*)(dst + i),
+                            _mm256_blendv_epi8(s, d, eq));
+    }
+    _mask_scalar(dst + i, src + i, mask, n - i);
+}
+
+
+__attribute__((target("avx2")))
+static void _scale_avx2(pixel_t* dst, const pixel_t* src, const int* cols,
+                        int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i idx = _mm256_loadu_si256((const __m256i*)(cols + i));
+        __m256i p = _mm256_i32gather_epi32((const int*)src, idx, 4);
+        _mm256_storeu_si256((__m256i*)(dst + i), p);
+    }
+    _scale_scalar(dst + i, src, cols + i, n - i);
+}
+
+
+// Pairs of bytes of `a` and `b` are weighed by the bytes pairs of `w`
+// (`w.lo` for the unpacked low halves of lanes, `w.hi` for the high
+// ones), summing to 256, with a single multiply-add: the components are
+// made signed by a bias of 128, which makes the weighted sum fit in 16
+// bits (rounded down like the scalar kernels).
+typedef struct {
+    __m256i lo, hi;
+} _lerp_weights_avx2_t;
+
+
+__attribute__((target("avx2")))
+static inline __m256i _lerp_avx2_8(__m256i a, __m256i b,
+                                   _lerp_weights_avx2_t w)
+{
+    __m256i bias = _mm256_set1_epi8(-128);
+    a = _mm256_xor_si256(a, bias);
+    b = _mm256_xor_si256(b, bias);
+    __m256i lo = _mm256_maddubs_epi16(w.lo, _mm256_unpacklo_epi8(a, b));
+    __m256i hi = _mm256_maddubs_epi16(w.hi, _mm256_unpackhi_epi8(a, b));
+    return _mm256_xor_si256(_mm256_packs_epi16(_mm256_srai_epi16(lo, 8),
+                                               _mm256_srai_epi16(hi, 8)),
+                            bias);
+}
+
+
+// `a` weighs 256 when `t` is 0, which is `a` weighing 128 twice.
+__attribute__((target("avx2")))
+static void _lerp_avx2(pixel_t* dst, const pixel_t* a, const pixel_t* b,
+                       int t, int n)
+{
+    __m256i vt = _mm256_set1_epi16(t ? t << 8 | (256 - t) : 0x8080);
+    _lerp_weights_avx2_t w = {vt, vt};
+    const pixel_t* next = t ? b : a;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i vb = _mm256_loadu_si256((const __m256i*)(next + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _lerp_avx2_8(va, vb, w));
+    }
+    _lerp_scalar(dst + i, a + i, b + i, t, n - i);
+}
+
+
+// Map of a block of 8 pixels: those sampling at most 8 consecutive
+// source pixels (when enlarging) are permuted from the first one,
+// others are gathered. The next pixel of those weighing 0 is themselves.
+typedef struct {
+    int32_t base;           /* First source column, -1 to gather */
+    int32_t a[8], b[8];     /* Columns of both pixels, from `base` */
+    uint8_t w[2][32];       /* Weights of the low and high unpacks */
+} _lerp_block_t;
+
+
+static void _scale_lerp_map_avx2(void* map, const int* cols,
+                                 const uint8_t* w, int n)
+{
+    _lerp_block_t* block = map;
+    int last = n > 0 ? cols[n - 1] + 1 : 0;
+    for (int i = 0; i + 8 <= n; i += 8, block++) {
+        int c = cols[i];
+        block->base = cols[i + 7] - c < 7 && c + 7 <= last ? c : -1;
+        int base = block->base < 0 ? 0 : c;
+        for (int k = 0; k < 8; k++) {
+            block->a[k] = cols[i + k] - base;
+            block->b[k] = block->a[k] + !!w[i + k];
+            // Unpacks interleave pixels 0, 1 (low) and 2, 3 (high) of
+            // each lane.
+            uint8_t* pair = block->w[k / 2 % 2] + k / 4 * 16 + k % 2 * 8;
+            for (int j = 0; j < 8; j += 2) {
+                pair[j] = w[i + k] ? 256 - w[i + k] : 128;
+                pair[j + 1] = w[i + k] ? w[i + k] : 128;
+            }
+        }
+    }
+}
+
+
+__attribute__((target("avx2")))
+static void _scale_lerp_avx2(pixel_t* dst, const pixel_t* src,
+                             const int* cols, const uint8_t* w,
+                             const void* map, int n)
+{
+    const _lerp_block_t* block = map;
+    int i = 0;
+    for (; i + 8 <= n; i += 8, block++) {
+        __m256i ia = _mm256_loadu_si256((const __m256i*)block->a);
+        __m256i ib = _mm256_loadu_si256((const __m256i*)block->b);
+        __m256i a, b;
+        if (block->base >= 0) {
+            __m256i p = _mm256_loadu_si256(
+                (const __m256i*)(src + block->base));
+            a = _mm256_permutevar8x32_epi32(p, ia);
+            b = _mm256_permutevar8x32_epi32(p, ib);
+        } else {
+            a = _mm256_i32gather_epi32((const int*)src, ia, 4);
+            b = _mm256_i32gather_epi32((const int*)src, ib, 4);
+        }
+        _lerp_weights_avx2_t vw = {
+            _mm256_loadu_si256((const __m256i*)block->w[0]),
+            _mm256_loadu_si256((const __m256i*)block->w[1]),
+        };
+        _mm256_storeu_si256((__m256i*)(dst + i), _lerp_avx2_8(a, b, vw));
+    }
+    _scale_lerp_scalar(dst + i, src, cols + i, w + i, NULL, n - i);
+}
+
+
+// Shuffles stay in 128 bits lanes: pixels are put back in order by
+// pairs.
+__attribute__((target("avx2")))
+static void _box_avx2(pixel_t* dst, const pixel_t* a, const pixel_t* b,
+                      int n)
+{
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v0 = _mm256_avg_epu8(
+            _mm256_loadu_si256((const __m256i*)(a + 2 * i)),
+            _mm256_loadu_si256((const __m256i*)(b + 2 * i)));
+        __m256i v1 = _mm256_avg_epu8(
+            _mm256_loadu_si256((const __m256i*)(a + 2 * i + 8)),
+            _mm256_loadu_si256((const __m256i*)(b + 2 * i + 8)));
+        __m256 f0 = _mm256_castsi256_ps(v0);
+        __m256 f1 = _mm256_castsi256_ps(v1);
+        __m256i even = _mm256_castps_si256(
+            _mm256_shuffle_ps(f0, f1, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m256i odd = _mm256_castps_si256(
+            _mm256_shuffle_ps(f0, f1, _MM_SHUFFLE(3, 1, 3, 1)));
+        __m256i avg = _mm256_avg_epu8(even, odd);
+        _mm256_storeu_si256((__m256i*)(dst + i),
+            _mm256_permute4x64_epi64(avg, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+    _box_scalar(dst + i, a + 2 * i, b + 2 * i, n - i);
+}
+#endif
+
+
+// ARM kernels --------------------------------------------------------
+#if defined(__ARM_NEON)
+static void _clear_neon(pixel_t* dst, pixel_t color, int n) {
+    uint32x4_t c = vdupq_n_u32(color);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_u32(dst + i, c);
+    }
+    _clear_scalar(dst + i, color, n - i);
+}
+
+
+static void _mask_neon(pixel_t* dst, const pixel_t* src, pixel_t mask,
+                       int n)
+{
+    uint32x4_t m = vdupq_n_u32(mask);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32x4_t s = vld1q_u32(src + i);
+        uint32x4_t d = vld1q_u32(dst + i);
+        vst1q_u32(dst + i, vbslq_u32(vceqq_u32(s, m), d, s));
+    }
+    _mask_scalar(dst + i, src + i, mask, n - i);
+}
+
+
+// a * (255 - t) + a + b * t, on 16 bits.
+static inline uint8x8_t _lerp_neon_2(uint8x8_t a, uint8x8_t b, uint8x8_t t) {
+    uint16x8_t x = vmlal_u8(vmovl_u8(a), a, vmvn_u8(t));
+    return vshrn_n_u16(vmlal_u8(x, b, t), 8);
+}
+
+
+static void _lerp_neon(pixel_t* dst, const pixel_t* a, const pixel_t* b,
+                       int t, int n)
+{
+    uint8x8_t vt = vdup_n_u8(t);
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        uint8x8_t va = vreinterpret_u8_u32(vld1_u32(a + i));
+        uint8x8_t vb = vreinterpret_u8_u32(vld1_u32(b + i));
+        vst1_u32(dst + i, vreinterpret_u32_u8(_lerp_neon_2(va, vb, vt)));
+    }
+    _lerp_scalar(dst + i, a + i, b + i, t, n - i);
+}
+
+
+// Pixels are loaded with the next one, then split.
+static void _scale_lerp_neon(pixel_t* dst, const pixel_t* src,
+                             const int* cols, const uint8_t* w,
+                             const void* map, int n)
+{
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        uint32x2x2_t p = vuzp_u32(vld1_u32(src + cols[i]),
+                                  vld1_u32(src + cols[i + 1]));
+        uint8x8_t t = vcreate_u8(w[i] * 0x01010101ull
+                                 | w[i + 1] * 0x0101010100000000ull);
+        uint8x8_t d = _lerp_neon_2(vreinterpret_u8_u32(p.val[0]),
+                                   vreinterpret_u8_u32(p.val[1]), t);
+        vst1_u32(dst + i, vreinterpret_u32_u8(d));
+    }
+    _scale_lerp_scalar(dst + i, src, cols + i, w + i, NULL, n - i);
+}
+
+
+// Loads split even and odd pixels.
+static void _box_neon(pixel_t* dst, const pixel_t* a, const pixel_t* b,
+                      int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint32x4x2_t va = vld2q_u32(a + 2 * i);
+        uint32x4x2_t vb = vld2q_u32(b + 2 * i);
+        uint8x16_t even = vrhaddq_u8(vreinterpretq_u8_u32(va.val[0]),
+                                     vreinterpretq_u8_u32(vb.val[0]));
+        uint8x16_t odd = vrhaddq_u8(vreinterpretq_u8_u32(va.val[1]),
+                                    vreinterpretq_u8_u32(vb.val[1]));
+        vst1q_u32(dst + i, vreinterpretq_u32_u8(vrhaddq_u8(even, odd)));
+    }
+    _box_scalar(dst + i, a + 2 * i, b + 2 * i, n - i);
+}
+#endif
+
+
+// Selection ----------------------------------------------------------
+static simd_kernels_t _KERNELS;
+static bool _selected = false;
+
+static const char* _LEVEL_NAMES[SIMD_LEVEL_MAX] = {
+    [SIMD_SCALAR] = "scalar",
+    [SIMD_SSE2] = "sse2",
+    [SIMD_SSSE3] = "ssse3",
+    [SIMD_AVX2] = "avx2",
+    [SIMD_NEON] = "neon",
+};
+
+
+bool simd_supported(simd_level_t level) {
+    switch (level) {
+      case SIMD_SCALAR:
+        return true;
+#if defined(__x86_64__) || defined(__i386__)
+      case SIMD_SSE2:
+        return __builtin_cpu_supports("sse2");
+      case SIMD_SSSE3:
+        return __builtin_cpu_supports("ssse3");
+      case SIMD_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+#if defined(__ARM_NEON)
+      case SIMD_NEON:
+        return true;
+#endif
+      default:
+        return false;
+    }
+}
+
+
+static simd_level_t _default_level() {
+    const char* name = getenv("JCFB_SIMD");
+    for (int l = 0; name && l < SIMD_LEVEL_MAX; l++) {
+        if (!strcmp(name, _LEVEL_NAMES[l]) && simd_supported(l)) {
+            return l;
+        }
+    }
+    // Ordered from the fastest to the slowest instruction set.
+    static const simd_level_t levels[] = {
+        SIMD_AVX2,
+        SIMD_SSSE3,
+        SIMD_SSE2,
+        SIMD_NEON,
+    };
+    for (size_t i = 0; i < sizeof(levels) / sizeof(levels[0]); i++) {
+        if (simd_supported(levels[i])) {
+            return levels[i];
+        }
+    }
+    return SIMD_SCALAR;
+}
+
+
+static void _select(simd_level_t level) {
+    _KERNELS = (simd_kernels_t){
+        .level = level,
+        .clear = _clear_scalar,
+        .copy = _copy,
+        .mask = _mask_scalar,
+        .scale = _scale_scalar,
+        .lerp = _lerp_scalar,
+        .scale_lerp = _scale_lerp_scalar,
+        .box = _box_scalar,
+    };
+    switch (level) {
+#if defined(__x86_64__) || defined(__i386__)
+      case SIMD_SSE2:
+      case SIMD_SSSE3:
+        _KERNELS.clear = _clear_sse2;
+        _KERNELS.mask = _mask_sse2;
+        _KERNELS.lerp = _lerp_sse2;
+        _KERNELS.scale_lerp = _scale_lerp_sse2;
+        _KERNELS.box = _box_sse2;
+        break;
+      case SIMD_AVX2:
+        _KERNELS.clear = _clear_avx2;
+        _KERNELS.mask = _mask_avx2;
+        _KERNELS.scale = _scale_avx2;
+        _KERNELS.lerp = _lerp_avx2;
+        _KERNELS.scale_lerp = _scale_lerp_avx2;
+        _KERNELS.scale_lerp_map = _scale_lerp_map_avx2;
+        _KERNELS.box = _box_avx2;
+        break;
+#endif
+#if defined(__ARM_NEON)
+      case SIMD_NEON:
+        _KERNELS.clear = _clear_neon;
+        _KERNELS.mask = _mask_neon;
+        _KERNELS.lerp = _lerp_neon;
+        _KERNELS.scale_lerp = _scale_lerp_neon;
+        _KERNELS.box = _box_neon;
+        break;
+#endif
+      default:
+        break;
+    }
+    pixel_fill_kernels(&_KERNELS);
+    _selected = true;
+}
+
+
+void simd_init() {
+    if (!_selected) {
+        _select(_default_level());
+    }
+}
+
+
+const simd_kernels_t* simd_kernels() {
+    simd_init();
+    return &_KERNELS;
+}
+
+
+int simd_set_level(simd_level_t level) {
+    if (level < 0 || level >= SIMD_LEVEL_MAX || !simd_supported(level)) {
+        return -1;
+    }
+    _select(level);
+    return 0;
+}
+
+
+simd_level_t simd_get_level() {
+    return simd_kernels()->level;
+}
+
+
+bool simd_has(simd_level_t level) {
+    simd_level_t selected = simd_get_level();
+    if (level == SIMD_SCALAR || level == selected) {
+        return true;
+    }
+    return level != SIMD_NEON && selected != SIMD_NEON && level < selected;
+}
+
+
+const char* simd_level_name(simd_level_t level) {
+    if (level < 0 || level >= SIMD_LEVEL_MAX) {
+        return "unknown";
+    }
+    return _LEVEL_NAMES[level];
+}
@@ -50,27 +50,38 @@ void ttf_render_cp(const ttf_font_t* font, int cp, bitmap_t* bmp,
                    int x, int y, int h, pixel_t color)
 {
     float scale = stbtt_ScaleForPixelHeight(&font->font_info, h);
-    int sw, sh, off_y;
-    unsigned char* bitmap = stbtt_GetCodepointBitmap(
-        &font->font_info, 0, scale, cp, &sw, &sh, 0, &off_y
-    );
-
     int base_line;
     stbtt_GetFontVMetrics(&font->font_info, &base_line, NULL, NULL);
     base_line *= scale;
 
-    // TODO handle dy < 0 & sy < 0 too
-    int diff = base_line + off_y;
-    int dy = min(y + diff, bmp->h - 1);
-    int sy = 0;
-    for (; dy < bmp->h && sy < sh; dy++, sy++) {
-        int dx = min(x, bmp->w - 1);
-        int sx = 0;
-        for (; dx < bmp->w && sx < sw; dx++, sx++) {
-            if (bitmap[sy * sw + sx] < 128) {
-                continue;
+    // Glyphs are clipped before being rasterized.
+    int x0, y0, x1, y1;
+    stbtt_GetCodepointBitmapBox(&font->font_info, cp, scale, scale,
+                                &x0, &y0, &x1, &y1);
+    int top = y + base_line + y0;
+    rect_t r = rect_intersect((rect_t){x, top, x1 - x0, y1 - y0},
+                              bmp->clip);
+    if (rect_is_empty(r)) {
+        return;
+    }
+    int sw, sh;
+    unsigned char* bitmap = stbtt_GetCodepointBitmap(
+        &font->font_info, 0, scale, cp, &sw, &sh, 0, 0
+    );
+    if (!bitmap) {
+        return;
+    }
+    r = rect_intersect(r, (rect_t){x, top, sw, sh});
+
+    // Damage the glyph at once, its pixels will be covered by it.
+    bitmap_add_damage(bmp, r.x, r.y, r.w, r.h);
+    for (int j = 0; j < r.h; j++) {
+        const unsigned char* s = bitmap + (r.y - top + j) * sw + r.x - x;
+        uint8_t* d = bitmap_addr(bmp, r.x, r.y + j);
+        for (int i = 0; i < r.w; i++) {
+            if (s[i] >= 128) {
+                pixel_store(d + i * bmp->psize, bmp->psize, color);
             }
-            bitmap_put_pixel(bmp, dx, dy, color);
         }
     }
 